@@ -0,0 +1,51 @@
+/*
+ * ESP32 Servo Choreography Example
+ *
+ * This sketch plays a fixed wave on one servo from a table of timer ticks
+ * that the compiler builds from three waypoints (see ServoChoreography.h).
+ * The table is constexpr, so it sits in flash and loop() only looks up one
+ * value per frame and writes it to the channel.
+ *
+ * The static_asserts below are sanity checks at compile time: the frame at
+ * the end of each waypoint is that waypoint's pulse width, and the first of
+ * them is also the tick count worked out by hand. That every frame matches
+ * what writeMicroseconds() would write is checked on a host, by
+ * extras/servo_check/choreography_check.cpp.
+ * Needs a core that compiles with C++14 or later.
+ */
+
+#include <ESP32_Servo.h>
+#include <ServoChoreography.h>
+
+constexpr ServoWaypoint wave[] = {
+  { 2000, 25, SERVO_EASE_IN_OUT },    // half a second up
+  { 1000, 50, SERVO_EASE_LINEAR },    // a second down
+  { 1500, 25, SERVO_EASE_OUT },       // and back to the middle
+};
+constexpr auto waveTrack =
+  servoCompileTrack<DEFAULT_TIMER_WIDTH, servoTrackLength(wave)>(1500, wave, 1000, 2000);
+
+static_assert(waveTrack.error == SERVO_TRACK_OK, "wave is invalid");
+static_assert(waveTrack.ticks[24] == servoUsToTicks(2000, DEFAULT_TIMER_WIDTH), "end of the first waypoint");
+static_assert(waveTrack.ticks[49] == servoUsToTicks(1500, DEFAULT_TIMER_WIDTH), "half way down, linear");
+static_assert(waveTrack.ticks[74] == servoUsToTicks(1000, DEFAULT_TIMER_WIDTH), "end of the second waypoint");
+static_assert(waveTrack.ticks[99] == servoUsToTicks(1500, DEFAULT_TIMER_WIDTH), "end of the wave");
+static_assert(waveTrack.ticks[24] == 6554, "2000 us of 20000 at 16 bits: 2000 * 65536 / 20000, rounded");
+
+Servo myservo;
+int frame = 0;
+unsigned long lastFrame = 0;
+
+void setup() {
+  myservo.attach(18, 1000, 2000);
+}
+
+void loop() {
+  // one table entry per PWM period
+  if (millis() - lastFrame >= REFRESH_USEC / 1000) {
+    lastFrame += REFRESH_USEC / 1000;
+    if (frame >= servoTrackLength(wave))
+      frame = 0;              // past the end: start over
+    servoPlayTrackFrame(myservo, waveTrack, frame++);
+  }
+}
@@ -0,0 +1,78 @@
+/*
+ * ESP32 Servo Frame Pipeline Example
+ *
+ * This sketch plans servo frames on one core and writes them on the other.
+ * A planning task on core 0 runs a ServoPlanner through a square path with
+ * two servos; the planner's group has a frame ring set, so every frame it
+ * commits goes into the ring. A commit task on core 1 wakes once per PWM
+ * period, writes the oldest frame from the ring to the servos, and then
+ * calls Servo::updateAll(). updateAll() writes the servos and their
+ * channels too (soft start, watchdogs, rate limits), so it belongs to the
+ * task that commits the frames, never to the planning task or loop().
+ * The planner is a static object, like everything else in the library:
+ * nothing is allocated.
+ *
+ * The planning task only produces a frame when the ring has space, so it
+ * never gets more than SERVO_FRAME_RING_SIZE frames ahead. Every few
+ * seconds loop() prints how many frames were written, dropped (ring full)
+ * and missed (ring empty at a period boundary).
+ */
+
+#include <ESP32_Servo.h>
+#include <ServoGroup.h>
+#include <ServoPlanner.h>
+#include <ServoFrameRing.h>
+
+Servo servo1;
+Servo servo2;
+ServoGroup group;
+ServoFrameRing ring;
+
+const int corners[4][2] = { { 1000, 1000 }, { 2000, 1000 }, { 2000, 2000 }, { 1000, 2000 } };
+
+void planTask(void *parameter) {
+  ServoPlanner *planner = (ServoPlanner *)parameter;
+  int corner = 0;
+  for (;;) {
+    if (ring.space() == 0) {
+      vTaskDelay(1);          // backpressure: wait for the commit task
+      continue;
+    }
+    if (planner->space() > 0) {
+      planner->add(corners[corner]);
+      corner = (corner + 1) % 4;
+    }
+    planner->update();        // commits into the ring
+  }
+}
+
+void commitTask(void *) {
+  TickType_t last = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&last, pdMS_TO_TICKS(REFRESH_USEC / 1000));
+    ring.commit(group);
+    Servo::updateAll();       // after the frame, on the same task
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  servo1.attach(18);
+  servo2.attach(19);
+  group.add(servo1);
+  group.add(servo2);
+  static ServoPlanner planner(group);   // once the servos are in the group
+  group.setFrameRing(&ring);
+  xTaskCreatePinnedToCore(planTask, "plan", 4096, &planner, 1, 0, 0);
+  xTaskCreatePinnedToCore(commitTask, "commit", 2048, 0, 2, 0, 1);
+}
+
+void loop() {
+  delay(5000);
+  Serial.print("written ");
+  Serial.print(ring.committed());
+  Serial.print(", dropped ");
+  Serial.print(ring.dropped());
+  Serial.print(", missed ");
+  Serial.println(ring.underruns());
+}
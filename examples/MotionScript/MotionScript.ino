@@ -0,0 +1,60 @@
+/*
+ * ESP32 Servo Motion Script Example
+ *
+ * This sketch assembles a small motion script once in setup(), and then
+ * runs it one frame at a time from loop(). Two servos wave three times,
+ * then both center together; the sequence repeats while the button on
+ * GPIO 0 is held down.
+ *
+ * The same script text could be assembled ahead of time on a PC (the
+ * assembler is plain C++), and the resulting bytes stored as a const array.
+ */
+
+#include <ESP32_Servo.h>
+#include <ServoScript.h>
+
+const char script[] =
+  "start:  set   r0 3        ; wave three times\n"
+  "wave:   move  0 0\n"
+  "        move  1 180\n"
+  "        wait  25          ; half a second at 50 frames/second\n"
+  "        move  0 180\n"
+  "        move  1 0\n"
+  "        wait  25\n"
+  "        djnz  r0 wave\n"
+  "        group 0x3         ; servos 0 and 1\n"
+  "        gmove 90\n"
+  "        wait  50\n"
+  "        jin   0 start     ; repeat while input 0 is set\n"
+  "        halt\n";
+
+Servo servo1;
+Servo servo2;
+Servo *servos[] = { &servo1, &servo2 };
+ServoScript player(servos, 2);
+uint8_t code[128];
+unsigned long lastFrame = 0;
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(0, INPUT_PULLUP);
+  servo1.attach(18);
+  servo2.attach(19);
+  int errorLine;
+  int length = servoScriptAssemble(script, code, sizeof(code), &errorLine);
+  if (length < 0) {
+    Serial.print("script error on line ");
+    Serial.println(errorLine);
+    return;
+  }
+  player.load(code, length);
+}
+
+void loop() {
+  // one script frame per PWM period
+  if (millis() - lastFrame >= REFRESH_USEC / 1000) {
+    lastFrame += REFRESH_USEC / 1000;
+    player.setInputs(digitalRead(0) == LOW ? 1 : 0);
+    player.runFrame();
+  }
+}
@@ -0,0 +1,18 @@
+/*
+  Arduino.h - Host stand-in for the parts of the Arduino core that the
+  library uses, for the host checks in this directory, which define them.
+  Not part of the library.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <math.h>
+
+unsigned long micros();
+unsigned long millis();
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+uint32_t analogReadMilliVolts(uint8_t pin);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+  choreography_check.cpp - Host check that compiled tracks match run time moves
+
+  Compiles tracks with servoCompileTrack() (ServoChoreography.h) and plays
+  the same waypoints at run time, with the LEDC driver simulated, checking
+  every frame:
+    - writeMicroseconds(servoEaseUs(...)) on a Servo attached with the
+      track's min and max and timer width (so through its clamping,
+      compensate() and the rounding of usToTicks()) puts the track's ticks
+      on the channel;
+    - the eased fraction a track is compiled with is the one servoEase()
+      gives at run time;
+    - for tracks of eased waypoints, a ServoController running them as
+      queueTimed() segments puts the track's ticks on the channel after
+      each update(). Linear waypoints are left out of this one: the
+      controller runs a linear segment at a constant speed, not along the
+      track's interpolation.
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++14 -O2 -Iextras/servo_check -Isrc extras/servo_check/choreography_check.cpp src/ESP32_Servo.cpp src/ServoGroup.cpp src/ServoController.cpp src/ServoEvents.cpp src/ServoEasing.cpp src/ServoSupply.cpp src/ServoConstraints.cpp src/ServoFrameRing.cpp -o choreography_check && ./choreography_check
+
+  It prints the first few failures and the totals, and exits with status 1
+  if anything failed.
+*/
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ESP32_Servo.h"
+#include "ServoChoreography.h"
+#include "ServoController.h"
+
+// ---- the simulated Arduino core and LEDC ----
+
+static uint32_t duty[MAX_SERVOS + 1];
+static long failures = 0;
+static long frames = 0;
+
+static void fail(const char *what, int a, int b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%d, %d)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return 0;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t value)
+{
+    duty[channel] = value;
+}
+
+void ledcAttachPin(uint8_t, uint8_t channel)
+{
+    duty[channel] = 0;
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+// ---- the tracks ----
+
+constexpr ServoWaypoint wave[] = {            // the Choreography example
+    { 2000, 25, SERVO_EASE_IN_OUT },
+    { 1000, 50, SERVO_EASE_LINEAR },
+    { 1500, 25, SERVO_EASE_OUT },
+};
+
+constexpr ServoWaypoint mixed[] = {           // every curve, both ways, odd lengths
+    { 600, 7, SERVO_EASE_IN },
+    { 2400, 13, SERVO_EASE_OUT },
+    { 2399, 1, SERVO_EASE_IN_OUT },
+    { 500, 41, SERVO_EASE_IN_OUT },
+    { 1501, 3, SERVO_EASE_LINEAR },
+    { 1501, 5, SERVO_EASE_IN },               // a pause
+    { 777, 99, SERVO_EASE_OUT },
+    { 2222, 64, SERVO_EASE_IN },
+};
+
+constexpr ServoWaypoint eased[] = {           // no linear waypoints: also run on a controller
+    { 1900, 17, SERVO_EASE_IN },
+    { 1100, 30, SERVO_EASE_IN_OUT },
+    { 1100, 4, SERVO_EASE_OUT },
+    { 2000, 9, SERVO_EASE_OUT },
+    { 1013, 50, SERVO_EASE_IN_OUT },
+};
+
+constexpr auto waveTrack = servoCompileTrack<DEFAULT_TIMER_WIDTH, servoTrackLength(wave)>(1500, wave, 1000, 2000);
+constexpr auto mixed16 = servoCompileTrack<16, servoTrackLength(mixed)>(1500, mixed, 500, 2500);
+constexpr auto mixed18 = servoCompileTrack<18, servoTrackLength(mixed)>(1500, mixed, 500, 2500);
+constexpr auto mixed20 = servoCompileTrack<20, servoTrackLength(mixed)>(1500, mixed, 500, 2500);
+constexpr auto eased16 = servoCompileTrack<16, servoTrackLength(eased)>(1500, eased, 900, 2100);
+constexpr auto eased19 = servoCompileTrack<19, servoTrackLength(eased)>(1500, eased, 900, 2100);
+
+// the track against writeMicroseconds() of the same eased widths
+template <int Width, int Frames, int N>
+static void checkWrites(const ServoTickTrack<Width, Frames> &track, int startUs,
+                        const ServoWaypoint (&points)[N], int minUs, int maxUs)
+{
+    if (track.error != SERVO_TRACK_OK)
+    {
+        fail("track not compiled", Width, track.error);
+        return;
+    }
+    Servo servo;
+    servo.setTimerWidth(Width);
+    servo.attach(1, minUs, maxUs);
+    int channel = servo.readChannel();
+    int out = 0;
+    int fromUs = startUs;
+    for (int i = 0; i < N; i++)
+    {
+        const ServoWaypoint &p = points[i];
+        for (int f = 1; f <= p.frames; f++, out++)
+        {
+            long t = (long)(((long long)f << 16) / p.frames);
+            if (servoEaseFraction(f, p.frames, p.easing) != servoEase(p.easing, t))
+                fail("compiled curve differs from servoEase()", out, p.easing);
+            servo.writeMicroseconds(servoEaseUs(fromUs, p.usec, f, p.frames, p.easing));
+            if (duty[channel] != (uint32_t)track.ticks[out])
+                fail("writeMicroseconds() differs from the track", out, (int)duty[channel] - (int)track.ticks[out]);
+            frames++;
+        }
+        fromUs = p.usec;
+    }
+}
+
+// the track against a ServoController running the waypoints as timed segments
+template <int Width, int Frames, int N>
+static void checkController(const ServoTickTrack<Width, Frames> &track, int startUs,
+                            const ServoWaypoint (&points)[N], int minUs, int maxUs)
+{
+    Servo servo;
+    servo.setTimerWidth(Width);
+    servo.attach(2, minUs, maxUs);
+    servo.writeMicroseconds(startUs);
+    int channel = servo.readChannel();
+    ServoGroup group;
+    group.add(servo);
+    ServoController controller(group);
+    for (int i = 0; i < N; i++)
+    {
+        if (!controller.queueTimed(0, points[i].usec, points[i].frames, points[i].easing))
+            fail("segment not queued", i, 0);
+    }
+    for (int out = 0; out < Frames; out++)
+    {
+        controller.update();
+        if (duty[channel] != (uint32_t)track.ticks[out])
+            fail("controller differs from the track", out, (int)duty[channel] - (int)track.ticks[out]);
+        frames++;
+    }
+    if (controller.moving(0))
+        fail("controller still moving at the end of the track", Frames, 0);
+}
+
+int main()
+{
+    checkWrites(waveTrack, 1500, wave, 1000, 2000);
+    checkWrites(mixed16, 1500, mixed, 500, 2500);
+    checkWrites(mixed18, 1500, mixed, 500, 2500);
+    checkWrites(mixed20, 1500, mixed, 500, 2500);
+    checkWrites(eased16, 1500, eased, 900, 2100);
+    checkWrites(eased19, 1500, eased, 900, 2100);
+    checkController(eased16, 1500, eased, 900, 2100);
+    checkController(eased19, 1500, eased, 900, 2100);
+    printf("%ld frames, %ld failures\n", frames, failures);
+    return ((failures == 0) ? 0 : 1);
+}
@@ -0,0 +1,269 @@
+/*
+  framering_check.cpp - Host check of ServoFrameRing across two threads
+
+  Runs a producer and a consumer on two std::threads, as the planning
+  and commit tasks run on the two ESP32 cores, with the LEDC driver
+  simulated, and checks that:
+    - frames filled in place with claim() and publish() arrive through
+      peek() and release() in order, numbered from 0, with their contents
+      intact; it prints the throughput;
+    - push() to a full ring counts a drop and queues nothing, and a
+      producer that waits for space() drops nothing;
+    - a ServoPlanner committing a group into the ring, with a planning
+      stall in the middle, feeds a commit thread that calls commit(group)
+      and then Servo::updateAll() every 200 us: every frame is committed,
+      in order, none is dropped, the stall shows up as underruns, and the
+      last frame planned is the one on the channels at the end; it prints
+      the latency from planning a frame to its commit.
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++11 -O2 -pthread -Iextras/servo_check -Isrc extras/servo_check/framering_check.cpp src/ServoFrameRing.cpp src/ServoPlanner.cpp src/ServoSupply.cpp src/ServoGroup.cpp src/ESP32_Servo.cpp src/ServoConstraints.cpp -o framering_check && ./framering_check
+
+  An optional argument sets the number of frames of the first two checks
+  (2000000 by default). Build it with -fsanitize=thread -g as well, and
+  run it with a smaller count such as 100000, to have ThreadSanitizer
+  look for data races between the two sides.
+  It prints the results, the first few failures and the totals, and
+  exits with status 1 if anything failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ServoFrameRing.h"
+#include "ServoPlanner.h"
+
+#define PIPELINE_FRAMES  5000
+#define PERIOD_USEC       200
+#define STALL_FRAME      2500
+#define STALL_MSEC          5
+
+typedef std::chrono::steady_clock Clock;
+
+// ---- the simulated Arduino core and LEDC ----
+
+static uint32_t duty[MAX_SERVOS + 1];       // written by the commit thread only
+static std::atomic<long> failures(0);
+
+static void fail(const char *what, long a, long b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%ld, %ld)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return 0;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t value)
+{
+    duty[channel] = value;
+}
+
+void ledcAttachPin(uint8_t, uint8_t channel)
+{
+    duty[channel] = 0;
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+// ---- the checks ----
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void checkInPlace(uint32_t count)
+{
+    static ServoFrameRing ring;
+    Clock::time_point start = Clock::now();
+    std::thread consumer([&] {
+        for (uint32_t n = 0; n < count; )
+        {
+            const ServoFrame *frame = ring.peek();
+            if (frame == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if ((frame->sequence != n) || (frame->ticks[0] != n) ||
+                (frame->ticks[MAX_SERVOS - 1] != n * 3 + MAX_SERVOS - 1))
+                fail("frame out of order or torn", (long)n, (long)frame->sequence);
+            ring.release();
+            n++;
+        }
+    });
+    for (uint32_t n = 0; n < count; )
+    {
+        ServoFrame *frame = ring.claim();
+        if (frame == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (int i = 0; i < MAX_SERVOS; i++)
+            frame->ticks[i] = (i == 0) ? n : n * 3 + i;
+        ring.publish();
+        n++;
+    }
+    consumer.join();
+    double seconds = secondsSince(start);
+    if ((ring.dropped() != 0) || (ring.available() != 0))
+        fail("in place: dropped or left over", (long)ring.dropped(), ring.available());
+    printf("in place: %u frames in order, %.2f M frames/s (%.0f ns per frame)\n",
+           count, count / seconds / 1e6, seconds * 1e9 / count);
+}
+
+static void checkPush(uint32_t count)
+{
+    static ServoFrameRing full;
+    uint32_t ticks[MAX_SERVOS] = { 0 };
+    int pushed = 0;
+    for (int i = 0; i < SERVO_FRAME_RING_SIZE + 12; i++)
+        pushed += full.push(ticks, MAX_SERVOS) ? 1 : 0;
+    if ((pushed != SERVO_FRAME_RING_SIZE) || (full.dropped() != 12) || (full.space() != 0) ||
+        (full.available() != SERVO_FRAME_RING_SIZE))
+        fail("push to a full ring", pushed, (long)full.dropped());
+
+    static ServoFrameRing ring;
+    std::thread consumer([&] {
+        for (uint32_t n = 0; n < count; )
+        {
+            const ServoFrame *frame = ring.peek();
+            if (frame == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if (frame->ticks[0] != n)
+                fail("pushed frame out of order", (long)n, (long)frame->ticks[0]);
+            ring.release();
+            n++;
+        }
+    });
+    for (uint32_t n = 0; n < count; n++)
+    {
+        while (ring.space() == 0)
+            std::this_thread::yield();          // backpressure
+        ticks[0] = n;
+        ring.push(ticks, 1);
+    }
+    consumer.join();
+    if (ring.dropped() != 0)
+        fail("dropped with backpressure", (long)ring.dropped(), 0);
+    printf("backpressure: %u dropped of %u\n", ring.dropped(), count);
+}
+
+static void checkPipeline()
+{
+    Servo servos[4];
+    ServoGroup group;
+    static ServoFrameRing ring;
+    for (int i = 0; i < 4; i++)
+    {
+        servos[i].attach(12 + i, 500, 2500);
+        group.add(servos[i]);
+    }
+    ServoPlanner planner(group);
+    group.setFrameRing(&ring);
+    std::vector<Clock::time_point> planned(PIPELINE_FRAMES);
+    std::vector<double> latency;
+    uint32_t last[4];
+
+    std::thread producer([&] {
+        int values[4];
+        for (int f = 0; f < PIPELINE_FRAMES; f++)
+        {
+            while (ring.space() == 0)
+                std::this_thread::yield();      // backpressure
+            if (((f % 40) == 0) && (planner.space() > 0))
+            {
+                for (int i = 0; i < 4; i++)
+                    values[i] = 1000 + (f * 7 + i * 100) % 1000;
+                planner.add(values);
+            }
+            if (f == STALL_FRAME)
+                std::this_thread::sleep_for(std::chrono::milliseconds(STALL_MSEC));
+            planned[f] = Clock::now();
+            planner.update();                   // commits the group into the ring
+        }
+        for (int i = 0; i < 4; i++)
+            last[i] = group.readStagedTicks(i);
+    });
+    std::thread commitTask([&] {
+        Clock::time_point next = Clock::now();
+        while (ring.committed() < (uint32_t)PIPELINE_FRAMES)
+        {
+            next += std::chrono::microseconds(PERIOD_USEC);
+            std::this_thread::sleep_until(next);
+            const ServoFrame *frame = ring.peek();
+            uint32_t sequence = (frame != 0) ? frame->sequence : 0;
+            if (ring.commit(group))
+            {
+                latency.push_back(std::chrono::duration<double, std::micro>(Clock::now() - planned[sequence]).count());
+                if (sequence != ring.committed() - 1)
+                    fail("pipeline frame committed out of order", (long)sequence, (long)ring.committed());
+            }
+            Servo::updateAll();
+        }
+    });
+    producer.join();
+    commitTask.join();
+
+    if (ring.dropped() != 0)
+        fail("pipeline dropped frames", (long)ring.dropped(), 0);
+    if (ring.underruns() == 0)
+        fail("planning stall without underruns", 0, 0);
+    for (int i = 0; i < 4; i++)
+    {
+        if (duty[servos[i].readChannel()] != last[i])
+            fail("last frame planned not on the channel", i, (long)duty[servos[i].readChannel()] - (long)last[i]);
+    }
+    std::sort(latency.begin(), latency.end());
+    printf("pipeline: %u frames committed in order, %u dropped, %u underruns (a %d ms stall is %d periods)\n",
+           ring.committed(), ring.dropped(), ring.underruns(), STALL_MSEC, STALL_MSEC * 1000 / PERIOD_USEC);
+    printf("latency from planning to commit: median %.0f us, p99 %.0f us (ring of %d, period %d us)\n",
+           latency[latency.size() / 2], latency[latency.size() * 99 / 100], SERVO_FRAME_RING_SIZE, PERIOD_USEC);
+    group.setFrameRing(0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = (argc > 1) ? (uint32_t)atol(argv[1]) : 2000000;
+    checkInPlace(count);
+    checkPush(count);
+    checkPipeline();
+    printf("%ld failures\n", failures.load());
+    return ((failures == 0) ? 0 : 1);
+}
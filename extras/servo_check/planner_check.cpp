@@ -0,0 +1,216 @@
+/*
+  planner_check.cpp - Host check of ServoPlanner's speed and acceleration limits
+
+  Runs a ServoPlanner on three servos with different limits (20, 12 and
+  30 us per frame, 2, 1 and 3 us per frame per frame), with the LEDC
+  driver simulated, along two paths of 400 points fed as space() allows,
+  each starting where the servos are:
+    - a circle on the first two servos with a zigzag on the third, and a
+      sharp corner every 50 points, so that servos reverse and turn hard;
+    - a plain circle on all three, where no servo reverses;
+  and checks every frame that:
+    - no servo moves further than its speed limit;
+    - no servo's velocity changes by more than its acceleration limit,
+      at junctions as much as along moves;
+    - the servos are where the planner says (the group was committed);
+  and that every path ends exactly at its last point, and that the plain
+  circle, once under way, never stands still before its end (the zigzag
+  does, where it turns back at a corner). Positions are whole microseconds,
+  rounded from the planner's fixed point, so each limit is allowed one
+  microsecond of rounding.
+  Then it measures planning throughput: add() with a full buffer behind it.
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++11 -O2 -Iextras/servo_check -Isrc extras/servo_check/planner_check.cpp src/ServoPlanner.cpp src/ServoSupply.cpp src/ServoGroup.cpp src/ESP32_Servo.cpp src/ServoConstraints.cpp src/ServoFrameRing.cpp -o planner_check && ./planner_check
+
+  It prints the peak speed and acceleration of every servo, the frames
+  each path took, the throughput, the first few failures and the totals,
+  and exits with status 1 if anything failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ServoPlanner.h"
+
+#define AXES      3
+#define POINTS  400
+
+// ---- the simulated Arduino core and LEDC ----
+
+static long failures = 0;
+
+static void fail(const char *what, int a, int b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%d, %d)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return 0;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t, uint32_t)
+{
+}
+
+void ledcAttachPin(uint8_t, uint8_t)
+{
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+// ---- the paths ----
+
+static const int maxSpeed[AXES] = { 20, 12, 30 };
+static const int maxAccel[AXES] = { 2, 1, 3 };
+
+static int zigzag[POINTS][AXES];
+static int circle[POINTS][AXES];
+
+static void makePaths()
+{
+    for (int k = 0; k < POINTS; k++)
+    {
+        double t = k * 2 * M_PI / 100;
+        zigzag[k][0] = 900 + (int)(600 * cos(t));
+        zigzag[k][1] = 1500 + (int)(600 * sin(t));
+        zigzag[k][2] = ((k % 20) < 10) ? 1000 + (k % 10) * 40 : 1400 - (k % 10) * 40;
+        if ((k % 50) == 49)
+            zigzag[k][0] += 200;                // a sharp corner out and back
+        circle[k][0] = 1500 + (int)(500 * cos(t));
+        circle[k][1] = 1500 + (int)(500 * sin(t));
+        circle[k][2] = 1500 + (int)(300 * sin(t));
+    }
+}
+
+// ---- the checks ----
+
+static void run(const char *name, ServoGroup &group, int (*path)[AXES], bool neverStill)
+{
+    for (int i = 0; i < AXES; i++)
+        group.servo(i)->writeMicroseconds(path[0][i]);   // the path starts where the servos are
+    ServoPlanner planner(group);
+    for (int i = 0; i < AXES; i++)
+        planner.setLimits(i, maxSpeed[i], maxAccel[i]);
+    int last[AXES];
+    int velocity[AXES] = { 0, 0, 0 };
+    int peakSpeed[AXES] = { 0, 0, 0 };
+    int peakAccel[AXES] = { 0, 0, 0 };
+    for (int i = 0; i < AXES; i++)
+        last[i] = planner.readPosition(i);
+    int next = 0;
+    int frames = 0;
+    int still = 0;
+    bool started = false;
+    while (((next < POINTS) || planner.busy()) && (frames < 100000))
+    {
+        while ((next < POINTS) && (planner.space() > 0))
+            planner.add(path[next++]);
+        planner.update();
+        frames++;
+        bool moved = false;
+        for (int i = 0; i < AXES; i++)
+        {
+            int pos = planner.readPosition(i);
+            int v = pos - last[i];
+            int a = abs(v - velocity[i]);
+            if (abs(v) > peakSpeed[i])
+                peakSpeed[i] = abs(v);
+            if (a > peakAccel[i])
+                peakAccel[i] = a;
+            if (abs(v) > maxSpeed[i] + 1)
+                fail("servo over its speed limit", i, v);
+            if (a > maxAccel[i] + 1)
+                fail("servo over its acceleration limit", i, a);
+            if (group.servo(i)->readMicroseconds() != pos)
+                fail("servo not at the planned position", i, group.servo(i)->readMicroseconds() - pos);
+            moved = moved || (v != 0);
+            velocity[i] = v;
+            last[i] = pos;
+        }
+        // from rest, the first step can round to no movement
+        if (!moved && planner.busy() && started)
+            still++;
+        started = started || moved;
+    }
+    for (int i = 0; i < AXES; i++)
+    {
+        if (planner.readPosition(i) != path[POINTS - 1][i])
+            fail("path did not end at its last point", i, planner.readPosition(i) - path[POINTS - 1][i]);
+        printf("%s, servo %d: peak speed %d (limit %d), peak acceleration %d (limit %d)\n",
+               name, i, peakSpeed[i], maxSpeed[i], peakAccel[i], maxAccel[i]);
+    }
+    printf("%s: %d frames, %d standing still\n", name, frames, still);
+    if (neverStill && (still != 0))
+        fail("path stood still before its end", still, 0);
+}
+
+static void bench(ServoGroup &group)
+{
+    ServoPlanner planner(group);
+    for (int i = 0; i < AXES; i++)
+        planner.setLimits(i, maxSpeed[i], maxAccel[i]);
+    long adds = 0;
+    int k = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while (seconds < 1.0)
+    {
+        for (int j = 0; j < 1000; j++, k++)
+        {
+            if (planner.space() == 0)
+                planner.update();
+            if (planner.add(zigzag[k % POINTS]))
+                adds++;
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    printf("planning: %.0f moves/s (%.1f us per add() with %d buffered)\n",
+           adds / seconds, seconds * 1e6 / adds, SERVO_PLANNER_BLOCKS);
+}
+
+int main()
+{
+    makePaths();
+    Servo servos[AXES];
+    ServoGroup group;
+    for (int i = 0; i < AXES; i++)
+    {
+        servos[i].attach(i + 1, 500, 2500);
+        servos[i].writeMicroseconds(1500);
+        group.add(servos[i]);
+    }
+    run("zigzag", group, zigzag, false);
+    run("circle", group, circle, true);
+    bench(group);
+    printf("%ld failures\n", failures);
+    return ((failures == 0) ? 0 : 1);
+}
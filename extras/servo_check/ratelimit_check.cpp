@@ -0,0 +1,186 @@
+/*
+  ratelimit_check.cpp - Host check of the PWM write rate limit
+
+  Writes a servo at 1 kHz for 10 s of simulated time (micros() advances
+  with it) and calls Servo::updateAll() at 50 Hz, with the LEDC driver
+  simulated, and checks that:
+    - with a REFRESH_USEC limit, the channel is written at most once per
+      REFRESH_USEC, so at most 500 times, through writeTicks() and through
+      ServoGroup commits alike;
+    - every write to the channel carries the newest value, the value on the
+      channel is never more than a period behind it, and the last one is
+      sent by updateAll() once the period is over;
+    - without a limit, every write reaches the channel;
+    - setTimerWidth() within the period puts the rescaled duty on the
+      channel at once (ledcSetup() has just reset it to 0), and counts as
+      the period's write.
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++11 -O2 -Iextras/servo_check -Isrc extras/servo_check/ratelimit_check.cpp src/ServoGroup.cpp src/ESP32_Servo.cpp src/ServoConstraints.cpp src/ServoFrameRing.cpp -o ratelimit_check && ./ratelimit_check
+
+  It prints the HAL writes and the largest lag of each run, the first few
+  failures and the totals, and exits with status 1 if anything failed.
+*/
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ServoGroup.h"
+
+#define RUN_MSEC      10000
+#define UPDATE_MSEC   (REFRESH_USEC / 1000)
+
+// ---- the simulated Arduino core and LEDC ----
+
+static uint32_t duty[MAX_SERVOS + 1];
+static long writes[MAX_SERVOS + 1];
+static unsigned long lastWrite[MAX_SERVOS + 1];
+static bool reset[MAX_SERVOS + 1];  // set up again since the last write: duty 0 on the pin
+static unsigned long now = 1000000;
+static int rateUsec = 0;            // the limit of the servo being checked
+static uint32_t newest = 0;         // the value last written by the application
+static long failures = 0;
+
+static void fail(const char *what, long a, long b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%ld, %ld)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return now;
+}
+
+unsigned long millis()
+{
+    return now / 1000;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return 0;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t value)
+{
+    if (!reset[channel] && (writes[channel] > 0) && (now - lastWrite[channel] < (unsigned long)rateUsec))
+        fail("channel written within the period", (long)(now - lastWrite[channel]), rateUsec);
+    reset[channel] = false;
+    if (value != newest)
+        fail("channel written with an old value", (long)value, (long)newest);
+    writes[channel]++;
+    lastWrite[channel] = now;
+    duty[channel] = value;
+}
+
+void ledcAttachPin(uint8_t, uint8_t channel)
+{
+    duty[channel] = 0;
+    reset[channel] = true;
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+// ---- the checks ----
+
+// 1 kHz writes, directly or through a group commit
+static void run(int limit, bool commit)
+{
+    Servo servo;
+    ServoGroup group;
+    servo.attach(4, 500, 2500);
+    group.add(servo);
+    rateUsec = limit;
+    servo.setRateLimit(limit);
+    int channel = servo.readChannel();
+    writes[channel] = 0;
+    unsigned long behindSince = 0;  // when the channel last fell behind the newest value
+    long lag = 0;
+    for (int ms = 0; ms < RUN_MSEC; ms++, now += 1000)
+    {
+        newest = 2000 + (ms % 6000);
+        if (commit)
+        {
+            group.stageTicks(0, newest);
+            group.commit();
+        }
+        else
+            servo.writeTicks(newest);
+        if ((ms % UPDATE_MSEC) == 0)
+            Servo::updateAll();
+        if (duty[channel] == newest)
+            behindSince = now;
+        else if ((long)(now - behindSince) > lag)
+            lag = now - behindSince;
+    }
+    if (lag > limit)
+        fail("channel behind the newest value for", lag, limit);
+    long sent = writes[channel];
+    long bound = (limit > 0) ? (long)RUN_MSEC * 1000 / limit : RUN_MSEC;
+    if (sent > bound)
+        fail("HAL writes over the bound", sent, bound);
+    if ((limit == 0) && (sent != RUN_MSEC))
+        fail("writes lost without a limit", sent, RUN_MSEC);
+
+    // the last value goes out from updateAll() once the period is over
+    now += REFRESH_USEC;
+    Servo::updateAll();
+    if (duty[channel] != newest)
+        fail("last value never sent", (long)duty[channel], (long)newest);
+    printf("limit %5d us, %s: %5ld HAL writes for %d commands, channel at most %ld us behind\n",
+           limit, commit ? "commits   " : "writeTicks", sent, RUN_MSEC, lag);
+    servo.detach();
+}
+
+static void checkTimerWidth()
+{
+    Servo servo;
+    servo.attach(4, 500, 2500);
+    rateUsec = REFRESH_USEC;
+    servo.setRateLimit(REFRESH_USEC);
+    int channel = servo.readChannel();
+    newest = 4000;
+    servo.writeTicks(newest);
+    now += 1000;
+    // within the period: the rescaled width goes out at once
+    newest = 4000 << 2;
+    long before = writes[channel];
+    servo.setTimerWidth(18);
+    if ((duty[channel] != newest) || (writes[channel] != before + 1))
+        fail("setTimerWidth() did not write the rescaled duty", (long)duty[channel], (long)newest);
+    // and a write right after it waits for the period
+    now += 1000;
+    newest = 20000;
+    servo.writeTicks(newest);
+    if (writes[channel] != before + 1)
+        fail("write after setTimerWidth() not held", writes[channel], before + 1);
+    now += REFRESH_USEC;
+    Servo::updateAll();
+    if (duty[channel] != newest)
+        fail("write after setTimerWidth() never sent", (long)duty[channel], (long)newest);
+    servo.detach();
+}
+
+int main()
+{
+    run(0, false);
+    run(REFRESH_USEC, false);
+    run(REFRESH_USEC, true);
+    checkTimerWidth();
+    printf("%ld failures\n", failures);
+    return ((failures == 0) ? 0 : 1);
+}
@@ -0,0 +1,382 @@
+/*
+  servo_check.cpp - Randomized host check of the Servo state machine
+
+  Drives random sequences of construct, destroy, attach, detach, write,
+  writeMicroseconds, writeTicks, setTimerWidth, setSoftStart,
+  setWatchdog, feedWatchdog and updateAll on a pool of Servo instances against a reference model, with
+  the LEDC driver simulated, and checks after every operation that the
+  library agrees with the model and the simulated hardware. Not part of the library; build and run it from
+  the repository root with:
+
+    g++ -std=gnu++11 -O2 -Iextras/servo_check -Isrc extras/servo_check/servo_check.cpp src/ESP32_Servo.cpp -o servo_check && ./servo_check
+
+  An optional argument sets the number of operations (5000000 by default).
+  It prints the first few failures, the totals and the rate, and exits
+  with status 1 if anything failed.
+
+  What is checked:
+    - attach() returns the servo's channel, or 0 only when no channel is
+      free; attached() follows attach() and detach().
+    - Attached servos have distinct channels, are registered on them
+      (Servo::fromChannel()), and their pins are attached to them.
+    - A width written is read back unchanged (after clamping to min and
+      max), an angle written is read back unchanged, and writeTicks()
+      clamps to the ticks of min and max.
+    - setTimerWidth() keeps the width within 16-20 and the pulse width of
+      an attached servo within 1 microsecond.
+    - The duty of an attached servo's channel is its ticks once written,
+      every duty fits the channel's timer width, and nothing is written to
+      a channel that no attached servo owns.
+    - A soft starting servo sends no pulses (a duty of 0) until it is
+      first written, whatever else is done to it.
+    - timedOut() becomes true exactly when an attached servo goes its
+      watchdog's frames without a write, whatever other servos (including
+      detached ones that used to own its channel) do to their watchdogs.
+    - Before the random run, a fixed sequence: a servo is detached and its
+      channel taken by a second one, whose watchdog fires and starts a
+      failsafe ramp; setWatchdog() and feedWatchdog() on the first servo
+      neither stop the ramp nor drop the second servo's next deadline.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <chrono>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ESP32_Servo.h"
+
+#define SLOTS         24      // more than MAX_SERVOS, so channels run out
+#define MAX_PIN       40
+
+// ---- the simulated Arduino core and LEDC ----
+
+static uint32_t duty[MAX_SERVOS + 1];
+static int width[MAX_SERVOS + 1];
+static int pinChannel[MAX_PIN];       // channel a pin is attached to, or -1
+static long failures = 0;
+
+static void fail(const char *what, int a, int b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%d, %d)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits)
+{
+    if ((channel < 1) || (channel > MAX_SERVOS) || (resolution_bits < 16) || (resolution_bits > 20))
+    {
+        fail("ledcSetup arguments", channel, resolution_bits);
+        return 0;
+    }
+    width[channel] = resolution_bits;
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t value)
+{
+    if ((channel < 1) || (channel > MAX_SERVOS))
+    {
+        fail("ledcWrite channel", channel, 0);
+        return;
+    }
+    bool owned = false;
+    for (int pin = 0; pin < MAX_PIN; pin++)
+        owned = owned || (pinChannel[pin] == channel);
+    if (!owned)
+        fail("ledcWrite to a channel with no pin", channel, (int)value);
+    if (value >= (1UL << width[channel]))
+        fail("ledcWrite duty over the timer width", (int)value, width[channel]);
+    duty[channel] = value;
+}
+
+// as in the ESP32 core, attaching a pin configures its channel with a duty of 0
+void ledcAttachPin(uint8_t pin, uint8_t channel)
+{
+    pinChannel[pin] = channel;
+    duty[channel] = 0;
+}
+
+void ledcDetachPin(uint8_t pin)
+{
+    if (pin >= MAX_PIN)
+    {
+        fail("ledcDetachPin of an invalid pin", pin, 0);
+        return;
+    }
+    pinChannel[pin] = -1;
+}
+
+// ---- the reference model ----
+
+struct Model
+{
+    bool live;          // constructed and not destroyed
+    bool attached;
+    bool written;       // a width was written since attach()
+    int min;
+    int max;
+    int width;
+    int watchdog;       // watchdog frames, 0 if off
+    long deadline;      // model frame at which the watchdog fires, -1 if not armed
+    bool fired;         // timedOut()
+};
+
+static long frame = 0;  // updateAll() calls so far
+
+static uint32_t seed = 12345;
+
+static int random(int n)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (int)((seed >> 8) % (uint32_t)n);
+}
+
+static int clamp(int value, int low, int high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+// a write or a feed: only an attached servo's deadline moves
+static void feed(Model &m)
+{
+    if (!m.attached)
+        return;
+    m.fired = false;
+    if (m.watchdog > 0)
+        m.deadline = frame + m.watchdog;
+}
+
+static void checkInvariants(Servo **servos, Model *model)
+{
+    uint32_t seen = 0;
+    for (int k = 0; k < SLOTS; k++)
+    {
+        if (!model[k].live)
+            continue;
+        Servo *s = servos[k];
+        if (s->timedOut() != model[k].fired)
+            fail("timedOut() differs from the model", k, model[k].fired);
+        if (!model[k].attached)
+            continue;
+        int channel = s->readChannel();
+        if ((channel < 1) || (channel > MAX_SERVOS) || (seen & (1UL << channel)))
+        {
+            fail("attached servos share a channel", k, channel);
+            continue;
+        }
+        seen |= (1UL << channel);
+        if (Servo::fromChannel(channel) != s)
+            fail("attached servo not registered on its channel", k, channel);
+        if (pinChannel[k] != channel)
+            fail("pin not attached to the servo's channel", k, pinChannel[k]);
+        if (model[k].written && !s->softStarting() && (duty[channel] != (uint32_t)s->readTicks()))
+            fail("channel duty differs from the servo's ticks", (int)duty[channel], s->readTicks());
+        if (!model[k].written && s->softStarting() && (duty[channel] != 0))
+            fail("soft starting servo pulsed before its first write", k, (int)duty[channel]);
+    }
+}
+
+static void updateAll()
+{
+    Servo::updateAll();
+    frame++;
+}
+
+// the watchdog of a detached servo whose channel another servo has taken
+static void checkStolenChannel()
+{
+    Servo a;
+    a.attach(0);
+    a.writeMicroseconds(1000);
+    a.detach();
+    Servo b;                                  // reuses the channel a freed
+    if (b.readChannel() != a.readChannel())
+        fail("channel not reused", a.readChannel(), b.readChannel());
+    b.attach(1);
+    b.setWatchdog(3, SERVO_FAILSAFE_SAFE, 2000, 100);
+    b.writeMicroseconds(1000);
+    for (int i = 0; i < 3; i++)
+        updateAll();                          // fires, and takes the first step
+    a.setWatchdog(3, SERVO_FAILSAFE_HOLD);
+    a.feedWatchdog();
+    updateAll();
+    if (!b.timedOut() || (b.readMicroseconds() != 1200))
+        fail("another servo's watchdog stopped the failsafe ramp", b.timedOut(), b.readMicroseconds());
+    b.writeMicroseconds(1500);                // deadline in 3 frames
+    a.setWatchdog(3, SERVO_FAILSAFE_HOLD);    // the same bucket
+    a.setWatchdog(0);
+    for (int i = 0; i < 3; i++)
+        updateAll();
+    if (!b.timedOut())
+        fail("another servo's watchdog dropped the deadline", b.readChannel(), 0);
+}
+
+int main(int argc, char **argv)
+{
+    long operations = (argc > 1) ? atol(argv[1]) : 5000000L;
+    alignas(Servo) static unsigned char memory[SLOTS][sizeof(Servo)];
+    Servo *servos[SLOTS];
+    Model model[SLOTS] = {};
+    for (int pin = 0; pin < MAX_PIN; pin++)
+        pinChannel[pin] = -1;
+    checkStolenChannel();
+
+    auto start = std::chrono::steady_clock::now();
+    for (long n = 0; n < operations; n++)
+    {
+        int k = random(SLOTS);
+        Servo *s = servos[k];
+        Model &m = model[k];
+        if (!m.live)
+        {
+            servos[k] = new (memory[k]) Servo();
+            m.live = true;
+            m.attached = false;
+            m.written = false;
+            m.min = DEFAULT_uS_LOW;
+            m.max = DEFAULT_uS_HIGH;
+            m.width = DEFAULT_TIMER_WIDTH;
+            m.watchdog = 0;
+            m.deadline = -1;
+            m.fired = false;
+            continue;
+        }
+        switch (random(13))
+        {
+            case 0:
+                if (random(4) == 0)
+                {
+                    s->~Servo();
+                    m.live = false;
+                }
+                break;
+            case 1:
+            {
+                int min = 400 + random(800);
+                int max = 1600 + random(1100);
+                int channel = s->attach(k, min, max);
+                if (channel > 0)
+                {
+                    if (!m.attached)
+                        m.written = false;
+                    m.attached = true;
+                    m.min = clamp(min, MIN_PULSE_WIDTH, min);
+                    m.max = clamp(max, max, MAX_PULSE_WIDTH);
+                    if (channel != s->readChannel())
+                        fail("attach() returned another channel", channel, s->readChannel());
+                }
+                else
+                {
+                    if (s->attached() != m.attached)
+                        fail("a failed attach() changed attached()", k, 0);
+                    for (int c = 1; c <= MAX_SERVOS; c++)
+                    {
+                        if (Servo::fromChannel(c) == 0)
+                            fail("attach() failed with a channel free", k, c);
+                    }
+                }
+                break;
+            }
+            case 2:
+                s->detach();
+                m.attached = false;
+                m.deadline = -1;
+                break;
+            case 3:
+            {
+                int value = random(3000);
+                s->writeMicroseconds(value);
+                m.written = m.attached;
+                feed(m);
+                if (m.attached && (s->readMicroseconds() != clamp(value, m.min, m.max)))
+                    fail("microseconds not read back", value, s->readMicroseconds());
+                break;
+            }
+            case 4:
+            {
+                int degrees = random(181);
+                s->write(degrees);
+                m.written = m.attached;
+                feed(m);
+                if (m.attached && (s->read() != degrees))
+                    fail("angle not read back", degrees, s->read());
+                break;
+            }
+            case 5:
+            {
+                int ticks = random(1 << 16);
+                s->writeTicks(ticks);
+                m.written = m.attached;
+                feed(m);
+                int low = servoUsToTicks(m.min, m.width);
+                int high = servoUsToTicks(m.max, m.width);
+                if (m.attached && (s->readTicks() != clamp(ticks, low, high)))
+                    fail("ticks not clamped to min and max", ticks, s->readTicks());
+                break;
+            }
+            case 6:
+            {
+                int requested = 14 + random(8);
+                int before = s->readMicroseconds();
+                s->setTimerWidth(requested);
+                m.width = clamp(requested, 16, 20);
+                if (s->readTimerWidth() != m.width)
+                    fail("timer width", requested, s->readTimerWidth());
+                int after = s->readMicroseconds();
+                if (m.attached && ((after - before > 1) || (before - after > 1)))
+                    fail("setTimerWidth() moved the servo", before, after);
+                break;
+            }
+            case 7:
+                s->setSoftStart(random(2) ? 0 : 1 + random(50));   // takes effect at the next attach()
+                break;
+            case 8:
+                updateAll();
+                for (int j = 0; j < SLOTS; j++)
+                {
+                    if (model[j].live && model[j].attached && (model[j].deadline == frame))
+                    {
+                        model[j].fired = true;      // SERVO_FAILSAFE_HOLD: nothing else happens
+                        model[j].deadline = -1;
+                    }
+                }
+                break;
+            case 9:
+                m.watchdog = random(3) ? 1 + random(80) : 0;   // longer than the wheel too
+                s->setWatchdog(m.watchdog, SERVO_FAILSAFE_HOLD);
+                m.deadline = -1;
+                feed(m);
+                m.fired = false;
+                break;
+            case 10:
+                s->feedWatchdog();
+                feed(m);
+                m.fired = false;
+                break;
+            default:
+                if (s->attached() != m.attached)
+                    fail("attached() differs from the model", k, m.attached);
+                break;
+        }
+        checkInvariants(servos, model);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%ld operations, %ld failures, %.1f M operations/s\n", operations, failures, operations / seconds / 1e6);
+    return ((failures == 0) ? 0 : 1);
+}
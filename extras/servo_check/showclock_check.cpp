@@ -0,0 +1,187 @@
+/*
+  showclock_check.cpp - Host check of ServoShowClock against a simulated timecode
+
+  Runs a ServoShowClock for ten minutes of simulated time, updated every
+  millisecond, following a timecode master that
+    - runs 300 ppm fast (and, in a second run, 300 ppm slow),
+    - has +-3 ms of random jitter on every reading,
+    - drops out for 10 s at 100 s,
+    - jumps 60 s ahead at 300 s (a cue jump),
+  and checks that:
+    - once locked (after 5 s), the show position stays within
+      MAX_ERROR_USEC of the master's true time;
+    - during the dropout, and for SETTLE_USEC after it and after the jump,
+      it stays within MAX_FREE_ERROR_USEC. The clock free-runs at the rate
+      correction it had when the timecode went away, which follows the
+      jitter, so the error grows by a few hundred ppm of the dropout;
+    - the position never goes backwards, and never moves by more than a
+      millisecond plus the largest slew in one update, except when it
+      seeks to the jump;
+    - the clock is locked at the end.
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++11 -O2 -Iextras/servo_check -Isrc extras/servo_check/showclock_check.cpp src/ServoShowClock.cpp src/ServoMotion.cpp src/ServoGroup.cpp src/ESP32_Servo.cpp src/ServoConstraints.cpp src/ServoFrameRing.cpp -o showclock_check && ./showclock_check
+
+  It prints the largest errors and step of each run, the first few
+  failures and the totals, and exits with status 1 if anything failed.
+*/
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ServoShowClock.h"
+
+#define MAX_ERROR_USEC     1500     // after lock
+#define MAX_FREE_ERROR_USEC 5000    // during the dropout and while settling after it
+#define SETTLE_USEC     5000000LL
+#define STEP_USEC          1000     // between updates
+#define RUN_USEC     600000000LL    // ten minutes
+#define LOCK_USEC      5000000LL
+#define DROPOUT_USEC 100000000LL    // from here
+#define DROPOUT_END  110000000LL
+#define JUMP_AT_USEC 300000000LL
+#define JUMP_USEC     60000000LL
+
+static long failures = 0;
+
+static void fail(const char *what, long long a, long long b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%lld, %lld)\n", what, a, b);
+}
+
+// the clock is updated with explicit times, so the core is never asked
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return 0;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t, uint32_t)
+{
+}
+
+void ledcAttachPin(uint8_t, uint8_t)
+{
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+static uint32_t seed = 12345;
+
+static int random(int n)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (int)((seed >> 8) % (uint32_t)n);
+}
+
+// the timecode master: true time runs ppm fast, readings jitter
+class Master : public ServoTimecodeSource
+{
+public:
+  int ppm = 0;
+  int64_t now = 0;              // local time, microseconds
+  int64_t jump = 0;
+  bool dropped = false;
+
+  int64_t truth()
+  {
+    return (this->now + this->now * this->ppm / 1000000 + this->jump);
+  }
+
+  bool readTimecode(int64_t *showUsec)
+  {
+    if (this->dropped)
+      return false;
+    *showUsec = this->truth() + random(6001) - 3000;
+    return true;
+  }
+};
+
+static void run(int ppm)
+{
+    Master master;
+    master.ppm = ppm;
+    ServoShowClock clock(master);
+    clock.begin(0);
+    int64_t last = clock.position();
+    int64_t worstError = 0;
+    int64_t worstFree = 0;
+    int64_t worstStep = 0;
+    for (int64_t now = STEP_USEC; now < RUN_USEC; now += STEP_USEC)
+    {
+        master.now = now;
+        master.dropped = (now >= DROPOUT_USEC) && (now < DROPOUT_END);
+        bool jumping = (now == JUMP_AT_USEC);
+        if (jumping)
+            master.jump = JUMP_USEC;
+        clock.update((uint32_t)now);
+
+        int64_t step = clock.position() - last;
+        last = clock.position();
+        if (step < 0)
+            fail("position went backwards", now, step);
+        if (!jumping)
+        {
+            if (step > worstStep)
+                worstStep = step;
+            if (step > STEP_USEC + STEP_USEC * SERVO_CLOCK_MAX_SLEW_PPM / 1000000 + 1)
+                fail("position jumped", now, step);
+        }
+        int64_t error = master.truth() - clock.position();
+        if (error < 0)
+            error = -error;
+        bool settling = ((now >= DROPOUT_USEC) && (now < DROPOUT_END + SETTLE_USEC)) ||
+                        ((now > JUMP_AT_USEC) && (now < JUMP_AT_USEC + SETTLE_USEC));
+        if ((now < LOCK_USEC) || jumping)
+            continue;
+        if (settling)
+        {
+            if (error > worstFree)
+                worstFree = error;
+            if (error > MAX_FREE_ERROR_USEC)
+                fail("position off the timecode in the dropout", now, error);
+        }
+        else
+        {
+            if (error > worstError)
+                worstError = error;
+            if (error > MAX_ERROR_USEC)
+                fail("position off the timecode", now, error);
+        }
+    }
+    if (!clock.locked())
+        fail("not locked at the end", ppm, 0);
+    printf("master %+d ppm: largest error %lld us locked, %lld us in the dropout and settling, largest step %lld us\n",
+           ppm, (long long)worstError, (long long)worstFree, (long long)worstStep);
+}
+
+int main()
+{
+    run(300);
+    run(-300);
+    printf("%ld failures\n", failures);
+    return ((failures == 0) ? 0 : 1);
+}
@@ -0,0 +1,442 @@
+/*
+  supply_check.cpp - Host check of ServoSupply and the classes it scales
+
+  Feeds synthetic supply voltage traces to a ServoSupply and runs a
+  ServoController, a ServoPlanner and a ServoArm under it, with the LEDC
+  driver simulated, checking every frame that:
+    - the scale is full at nominal, follows the linear ramp from nominal
+      down to low at once as the voltage falls, and is 0 with the moves
+      deferred below critical, exactly once per dip;
+    - moves stay deferred while the voltage is back between critical and
+      low, and resume once the filtered voltage is above low, without the
+      scale going back down as it rises;
+    - the pin is read through the divider in millivolts;
+    - ServoController steps no servo further than its speed (or the full
+      speed, for an unlimited move) times the scale, and holds every servo
+      while the moves are deferred;
+    - ServoPlanner, slowed down in the middle of a move, changes no servo's
+      velocity by more than its acceleration in a frame, then keeps under
+      the scaled speed, and holds the path while the moves are deferred;
+    - ServoArm holds the tool while the moves are deferred, and takes four
+      times as many frames at a quarter of the speed;
+    - all three write exactly the same duties with no supply set as with a
+      supply at nominal, and every move ends at its target.
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++11 -O2 -Iextras/servo_check -Isrc extras/servo_check/supply_check.cpp src/ServoSupply.cpp src/ServoController.cpp src/ServoPlanner.cpp src/ServoArm.cpp src/ServoEvents.cpp src/ServoEasing.cpp src/ServoGroup.cpp src/ESP32_Servo.cpp src/ServoConstraints.cpp src/ServoFrameRing.cpp -o supply_check && ./supply_check
+
+  It prints the first few failures and the totals, and exits with status 1
+  if anything failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ServoController.h"
+#include "ServoPlanner.h"
+#include "ServoArm.h"
+
+#define FRAMES        600     // longest run
+#define MIN_SCALE     (SERVO_SUPPLY_SCALE_ONE / 4)
+
+// ---- the simulated Arduino core and LEDC ----
+
+static uint32_t duty[MAX_SERVOS + 1];
+static uint32_t pinMillivolts = 0;
+static long failures = 0;
+static long frames = 0;
+
+static void fail(const char *what, int a, int b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%d, %d)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return pinMillivolts;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t value)
+{
+    duty[channel] = value;
+}
+
+void ledcAttachPin(uint8_t, uint8_t channel)
+{
+    duty[channel] = 0;
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+// ---- the traces ----
+
+// nominal, a sag through the ramp, a dip below critical, back between
+// critical and low (still deferred), then a recovery
+static int sagTrace(int f)
+{
+    if (f < 10)
+        return 6400;
+    if (f < 30)
+        return 6400 - (f - 10) * 70;
+    if (f < 40)
+        return 4700;
+    if (f < 60)
+        return 5000 + (f - 40) * 10;
+    return 6300;
+}
+
+static int rampScale(int mv)
+{
+    if (mv >= 6000)
+        return SERVO_SUPPLY_SCALE_ONE;
+    if (mv <= 5200)
+        return MIN_SCALE;
+    return MIN_SCALE + (SERVO_SUPPLY_SCALE_ONE - MIN_SCALE) * (mv - 5200) / 800;
+}
+
+static void checkSupply()
+{
+    ServoSupply supply;
+    int lastMv = 0;
+    int lastScale = SERVO_SUPPLY_SCALE_ONE;
+    bool resumed = false;
+    for (int f = 0; f < 200; f++, frames++)
+    {
+        int mv = sagTrace(f);
+        supply.update(mv);
+        int scale = supply.readScale();
+        if (f < 30)
+        {
+            // falling: followed at once, along the ramp
+            if (supply.readMillivolts() != mv)
+                fail("falling voltage filtered", f, supply.readMillivolts());
+            if (scale != rampScale(mv))
+                fail("scale off the ramp", mv, scale);
+            if (supply.deferred())
+                fail("deferred above critical", f, mv);
+        }
+        else if (f < 60)
+        {
+            if (!supply.deferred() || (scale != 0))
+                fail("not deferred below low after the dip", f, scale);
+        }
+        else
+        {
+            // rising: filtered, and never bouncing back down
+            if ((supply.readMillivolts() < lastMv) || (supply.readMillivolts() > mv))
+                fail("rising voltage not filtered", f, supply.readMillivolts());
+            if (supply.deferred() != (supply.readMillivolts() <= 5200) && !resumed)
+                fail("deferral not ended above low", f, supply.readMillivolts());
+            if (!supply.deferred())
+            {
+                resumed = true;
+                if (scale < lastScale)
+                    fail("scale went down on a rising supply", f, scale);
+                if (scale != rampScale(supply.readMillivolts()))
+                    fail("scale off the ramp while rising", supply.readMillivolts(), scale);
+            }
+        }
+        lastMv = supply.readMillivolts();
+        lastScale = supply.deferred() ? 0 : scale;
+    }
+    if (!resumed || (supply.readScale() != SERVO_SUPPLY_SCALE_ONE))
+        fail("not back to full speed", supply.readMillivolts(), supply.readScale());
+    if (supply.deferrals() != 1)
+        fail("deferrals of one dip", (int)supply.deferrals(), 1);
+
+    // 30k over 10k: 1600 mV at the pin is 6400 mV at the supply
+    ServoSupply divided(34, 30000, 10000);
+    pinMillivolts = 1600;
+    divided.update();
+    if ((divided.readMillivolts() != 6400) || (divided.readScale() != SERVO_SUPPLY_SCALE_ONE))
+        fail("divider", divided.readMillivolts(), divided.readScale());
+    pinMillivolts = 1225;
+    divided.update();
+    if ((divided.readMillivolts() != 4900) || divided.deferred())
+        fail("divider at 4900 mV", divided.readMillivolts(), divided.deferred());
+    pinMillivolts = 1175;
+    divided.update();
+    if (!divided.deferred())
+        fail("divider at 4700 mV not deferred", divided.readMillivolts(), 0);
+    frames += 3;
+}
+
+// ---- ServoController ----
+
+// the duties of every frame, to compare runs with and without a supply
+typedef std::vector<uint32_t> Trace;
+
+static Trace runController(ServoSupply *supply, int (*trace)(int))
+{
+    Trace out;
+    Servo servos[3];
+    ServoGroup group;
+    for (int i = 0; i < 3; i++)
+    {
+        servos[i].attach(i + 1, 500, 2500);
+        servos[i].writeMicroseconds(600);
+        group.add(servos[i]);
+    }
+    ServoController controller(group);
+    if (supply)
+        controller.setSupply(supply);
+    int speed[3] = { 20, 10, 0 };
+    controller.moveTo(0, 2400, speed[0]);
+    controller.moveTo(1, 2400, speed[1]);
+    int last[3];
+    for (int i = 0; i < 3; i++)
+        last[i] = controller.readPosition(i);
+    for (int f = 0; f < FRAMES; f++, frames++)
+    {
+        if (supply)
+            supply->update(trace(f));
+        if (f == 15)
+            controller.moveTo(2, 2400, speed[2]);       // unlimited, started on a sagging supply
+        controller.update();
+        int scale = supply ? supply->readScale() : SERVO_SUPPLY_SCALE_ONE;
+        for (int i = 0; i < 3; i++)
+        {
+            int pos = controller.readPosition(i);
+            int step = abs(pos - last[i]);
+            last[i] = pos;
+            out.push_back(duty[servos[i].readChannel()]);
+            if (scale == 0)
+            {
+                if (step != 0)
+                    fail("controller moved while deferred", f, i);
+                continue;
+            }
+            int limit = speed[i];
+            if (scale < SERVO_SUPPLY_SCALE_ONE)
+            {
+                if (limit == 0)
+                    limit = supply->readFullSpeed();
+                limit = (limit * scale) >> 8;
+                if (limit < 1)
+                    limit = 1;
+            }
+            if ((limit > 0) && (step > limit + 1))
+                fail("controller step over the scaled speed", f, step - limit);
+        }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        if (controller.moving(i) || (controller.readPosition(i) != 2400))
+            fail("controller move did not end at its target", i, controller.readPosition(i));
+    }
+    return out;
+}
+
+static int nominalTrace(int)
+{
+    return 6400;
+}
+
+static void checkController()
+{
+    ServoSupply sagging;
+    runController(&sagging, sagTrace);
+    ServoSupply nominal;
+    if (runController(0, nominalTrace) != runController(&nominal, nominalTrace))
+        fail("controller output changed by a nominal supply", 0, 0);
+}
+
+// ---- ServoPlanner ----
+
+#define PLANNER_SPEED  20
+#define PLANNER_ACCEL   2
+
+// full speed, a drop to below low in the middle of the first move, a dip
+// below critical in the second, then a recovery
+static int plannerTrace(int f)
+{
+    if (f < 40)
+        return 7000;
+    if (f < 120)
+        return 5100;
+    if (f < 130)
+        return 4700;
+    return 7000;
+}
+
+static Trace runPlanner(ServoSupply *supply, int (*trace)(int))
+{
+    Trace out;
+    Servo servos[2];
+    ServoGroup group;
+    for (int i = 0; i < 2; i++)
+    {
+        servos[i].attach(i + 1, 500, 2500);
+        group.add(servos[i]);
+    }
+    ServoPlanner planner(group);
+    for (int i = 0; i < 2; i++)
+        planner.setLimits(i, PLANNER_SPEED, PLANNER_ACCEL);
+    if (supply)
+        planner.setSupply(supply);
+    int start[2] = { 600, 600 };
+    int up[2] = { 2400, 2400 };
+    int across[2] = { 600, 2400 };
+    planner.add(start);
+    planner.add(up);
+    planner.add(across);
+    int last[2] = { 0, 0 };
+    int velocity[2] = { 0, 0 };
+    int slowFrom = -1;
+    for (int f = 0; f < FRAMES; f++, frames++)
+    {
+        if (supply)
+            supply->update(trace(f));
+        planner.update();
+        int scale = supply ? supply->readScale() : SERVO_SUPPLY_SCALE_ONE;
+        if ((scale < SERVO_SUPPLY_SCALE_ONE) && (slowFrom < 0))
+            slowFrom = f;
+        for (int i = 0; i < 2; i++)
+        {
+            int pos = planner.readPosition(i);
+            int v = (f == 0) ? 0 : pos - last[i];
+            last[i] = pos;
+            if (f > 0)
+            {
+                if (scale == 0)
+                {
+                    if (v != 0)
+                        fail("planner moved while deferred", f, i);
+                }
+                else if (abs(v - velocity[i]) > PLANNER_ACCEL + 1)
+                    fail("planner velocity change over the acceleration", f, v - velocity[i]);
+                if (abs(v) > PLANNER_SPEED + 1)
+                    fail("planner over the speed limit", f, v);
+                // slowed down (at half the acceleration along a move), then held under the scaled speed
+                if ((scale > 0) && (scale < SERVO_SUPPLY_SCALE_ONE) && (f > slowFrom + 2 * PLANNER_SPEED / PLANNER_ACCEL) &&
+                    (abs(v) > ((PLANNER_SPEED * scale) >> 8) + 1))
+                    fail("planner over the scaled speed", f, v);
+            }
+            velocity[i] = v;
+            out.push_back(duty[servos[i].readChannel()]);
+        }
+    }
+    if (planner.busy() || (planner.readPosition(0) != 600) || (planner.readPosition(1) != 2400))
+        fail("planner path did not end at its target", planner.readPosition(0), planner.readPosition(1));
+    return out;
+}
+
+static void checkPlanner()
+{
+    ServoSupply sagging;
+    runPlanner(&sagging, plannerTrace);
+    ServoSupply nominal;
+    if (runPlanner(0, nominalTrace) != runPlanner(&nominal, nominalTrace))
+        fail("planner output changed by a nominal supply", 0, 0);
+}
+
+// ---- ServoArm ----
+
+// a move of 1000 (0.1 mm) at 10 per frame: 100 frames at full speed
+static Trace runArm(ServoSupply *supply, int (*trace)(int), int *took)
+{
+    Trace out;
+    Servo servos[2];
+    ServoGroup group;
+    for (int i = 0; i < 2; i++)
+    {
+        servos[i].attach(i + 1, 500, 2500);
+        group.add(servos[i]);
+    }
+    ServoArm arm(group);
+    arm.setLinks(1000, 1000);
+    arm.setJoint(SERVO_ARM_SHOULDER, 0, 1500, 700);
+    arm.setJoint(SERVO_ARM_ELBOW, 1, 1500, -700);
+    if (supply)
+        arm.setSupply(supply);
+    if (!arm.begin(1500, -500) || !arm.moveTo(1500, 500, 0, 10))
+        fail("arm move not started", 0, 0);
+    *took = -1;
+    for (int f = 0; f < FRAMES; f++, frames++)
+    {
+        uint32_t before[2] = { duty[servos[0].readChannel()], duty[servos[1].readChannel()] };
+        long x = arm.readX();
+        long y = arm.readY();
+        if (supply)
+            supply->update(trace(f));
+        arm.update();
+        if (supply && supply->deferred())
+        {
+            if ((arm.readX() != x) || (arm.readY() != y) || (duty[servos[0].readChannel()] != before[0]) ||
+                (duty[servos[1].readChannel()] != before[1]))
+                fail("arm moved while deferred", f, (int)arm.readY());
+        }
+        if (!arm.moving() && (*took < 0))
+            *took = f + 1;
+        for (int i = 0; i < 2; i++)
+            out.push_back(duty[servos[i].readChannel()]);
+    }
+    if (arm.moving() || arm.blocked() || (arm.readX() != 1500) || (arm.readY() != 500))
+        fail("arm move did not end at its target", (int)arm.readX(), (int)arm.readY());
+    return out;
+}
+
+static int lowTrace(int)
+{
+    return 5000;
+}
+
+// deferred for the first 50 frames, then back
+static int dipTrace(int f)
+{
+    return (f < 50) ? 4700 : 7000;
+}
+
+static void checkArm()
+{
+    int full, nominal, low, dipped;
+    ServoSupply atNominal;
+    if (runArm(0, nominalTrace, &full) != runArm(&atNominal, nominalTrace, &nominal))
+        fail("arm output changed by a nominal supply", full, nominal);
+    if (full != 100)
+        fail("arm move at full speed", full, 100);
+    ServoSupply atLow;
+    runArm(&atLow, lowTrace, &low);
+    if (low != full * SERVO_SUPPLY_SCALE_ONE / MIN_SCALE)
+        fail("arm move at the minimum scale", low, full * SERVO_SUPPLY_SCALE_ONE / MIN_SCALE);
+    ServoSupply dipping;
+    runArm(&dipping, dipTrace, &dipped);
+    if (dipped <= full + 50)
+        fail("arm move not held by the dip", dipped, full);
+}
+
+int main()
+{
+    checkSupply();
+    checkController();
+    checkPlanner();
+    checkArm();
+    printf("%ld frames, %ld failures\n", frames, failures);
+    return ((failures == 0) ? 0 : 1);
+}
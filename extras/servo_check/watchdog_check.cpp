@@ -0,0 +1,269 @@
+/*
+  watchdog_check.cpp - Host check of the command watchdog timing
+
+  Runs Servo::updateAll() frame by frame on servos with watchdogs, with the
+  LEDC driver simulated, and checks the exact frame of every timeout:
+    - a 5 frame watchdog written at frame 0 fires at frame 5, and a write
+      at frame 3 moves the deadline to frame 8; feedWatchdog() and a
+      ServoGroup commit move it the same way;
+    - SERVO_FAILSAFE_HOLD keeps the last duty and the pin attached;
+    - SERVO_FAILSAFE_SAFE ramps to the safe width at its speed, one step
+      per frame starting at the frame it fires, and stops there; a write
+      mid-ramp stops it at once, until the next deadline;
+    - SERVO_FAILSAFE_DETACH stops the pulses exactly at its frame (40,
+      more than a turn of the timing wheel), and so does a 100 frame
+      watchdog;
+    - a servo written every frame never times out.
+  Then it measures the cost of updateAll() per frame with 16 watched
+  servos, one of them written each frame, against an idle updateAll().
+  Not part of the library; build and run it from the repository root
+  with:
+
+    g++ -std=gnu++11 -O2 -Iextras/servo_check -Isrc extras/servo_check/watchdog_check.cpp src/ServoGroup.cpp src/ESP32_Servo.cpp src/ServoConstraints.cpp src/ServoFrameRing.cpp -o watchdog_check && ./watchdog_check
+
+  It prints the costs, the first few failures and the totals, and exits
+  with status 1 if anything failed.
+*/
+
+#include <stdio.h>
+#include <chrono>
+#include "Arduino.h"
+#include "esp32-hal-ledc.h"
+#include "ServoGroup.h"
+
+#define BENCH_FRAMES  1000000
+
+// ---- the simulated Arduino core and LEDC ----
+
+static uint32_t duty[MAX_SERVOS + 1];
+static long failures = 0;
+
+static void fail(const char *what, int a, int b)
+{
+    if (failures++ < 10)
+        printf("FAIL %s (%d, %d)\n", what, a, b);
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+unsigned long millis()
+{
+    return 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return 0;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t value)
+{
+    duty[channel] = value;
+}
+
+void ledcAttachPin(uint8_t, uint8_t channel)
+{
+    duty[channel] = 0;
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+// ---- the checks ----
+
+// frame at which the servo is first seen timed out after updateAll(), or -1
+static int firesAt(Servo &servo, int frames, int writeAt = -1, int feedAt = -1)
+{
+    for (int f = 1; f <= frames; f++)
+    {
+        Servo::updateAll();
+        if (servo.timedOut())
+            return f;
+        if (f == writeAt)
+            servo.writeMicroseconds(1600);
+        if (f == feedAt)
+            servo.feedWatchdog();
+    }
+    return -1;
+}
+
+static void checkDeadlines()
+{
+    Servo servo;
+    servo.attach(1, 500, 2500);
+    servo.setWatchdog(5, SERVO_FAILSAFE_HOLD);
+    servo.writeMicroseconds(2000);
+    int at = firesAt(servo, 20);
+    if (at != 5)
+        fail("5 frame watchdog fired at", at, 5);
+    uint32_t held = duty[servo.readChannel()];
+    for (int f = 0; f < 10; f++)
+        Servo::updateAll();
+    if (!servo.attached() || (duty[servo.readChannel()] != held) || !servo.timedOut())
+        fail("hold did not hold", (int)held, (int)duty[servo.readChannel()]);
+
+    servo.writeMicroseconds(2000);
+    if (servo.timedOut())
+        fail("timedOut() after a write", 0, 0);
+    at = firesAt(servo, 20, 3);
+    if (at != 8)
+        fail("write at frame 3 moved the deadline to", at, 8);
+
+    servo.writeMicroseconds(2000);
+    at = firesAt(servo, 20, -1, 3);
+    if (at != 8)
+        fail("feed at frame 3 moved the deadline to", at, 8);
+
+    // a commit is a write
+    ServoGroup group;
+    group.add(servo);
+    servo.writeMicroseconds(2000);
+    for (int f = 1; f <= 20; f++)
+    {
+        Servo::updateAll();
+        if (servo.timedOut())
+        {
+            if (f != 9)
+                fail("commit at frame 4 moved the deadline to", f, 9);
+            break;
+        }
+        if (f == 4)
+        {
+            group.stageMicroseconds(0, 1700);
+            group.commit();
+        }
+    }
+
+    // written every frame: never
+    servo.writeMicroseconds(2000);
+    for (int f = 1; f <= 200; f++)
+    {
+        Servo::updateAll();
+        if (servo.timedOut())
+        {
+            fail("timed out while written every frame", f, 0);
+            break;
+        }
+        servo.writeMicroseconds(1000 + f);
+    }
+    servo.detach();
+}
+
+static void checkSafeRamp()
+{
+    Servo servo;
+    servo.attach(1, 500, 2500);
+    servo.setWatchdog(5, SERVO_FAILSAFE_SAFE, 1000, 100);
+    servo.writeMicroseconds(2000);
+    int last = 2000;
+    for (int f = 1; f <= 30; f++)
+    {
+        Servo::updateAll();
+        int us = servo.readMicroseconds();
+        if (f < 5)
+        {
+            if ((us != 2000) || servo.timedOut())
+                fail("ramp before the deadline", f, us);
+        }
+        else if (f <= 14)
+        {
+            // steps of 100 us, within the rounding of ticks
+            int step = last - us;
+            if (!servo.timedOut() || (step < 99) || (step > 101))
+                fail("ramp step", f, step);
+        }
+        else if (us != 1000)
+            fail("ramp did not stop at the safe width", f, us);
+        last = us;
+    }
+
+    // the application writes again mid-ramp; 5 frames later it fires again
+    servo.writeMicroseconds(2000);
+    for (int f = 1; f <= 13; f++)
+    {
+        Servo::updateAll();
+        if (f == 8)
+            servo.writeMicroseconds(1800);
+        else if ((f > 8) && (f < 13))
+        {
+            if ((servo.readMicroseconds() != 1800) || servo.timedOut())
+                fail("ramp went on after a write", f, servo.readMicroseconds());
+        }
+    }
+    if (!servo.timedOut() || (servo.readMicroseconds() >= 1800))
+        fail("ramp not restarted 5 frames after the write", servo.timedOut(), servo.readMicroseconds());
+    servo.detach();
+}
+
+static void checkDetach(int frames)
+{
+    Servo servo;
+    servo.attach(1, 500, 2500);
+    servo.setWatchdog(frames, SERVO_FAILSAFE_DETACH);
+    servo.writeMicroseconds(2000);
+    for (int f = 1; f <= frames + 5; f++)
+    {
+        Servo::updateAll();
+        if (servo.attached() != (f < frames))
+        {
+            fail("detach at the wrong frame", f, frames);
+            break;
+        }
+    }
+    if (!servo.timedOut())
+        fail("detach without timedOut()", frames, 0);
+}
+
+static double perFrame(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e9 / BENCH_FRAMES;
+}
+
+static void bench()
+{
+    Servo servos[16];
+    for (int i = 0; i < 16; i++)
+    {
+        servos[i].attach(i + 1, 500, 2500);
+        servos[i].setWatchdog(25, SERVO_FAILSAFE_SAFE, 1500, 10);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < BENCH_FRAMES; f++)
+    {
+        servos[f & 15].writeMicroseconds(1000 + (f & 511));
+        Servo::updateAll();
+    }
+    double watched = perFrame(start);
+    for (int i = 0; i < 16; i++)
+        servos[i].setWatchdog(0);
+    start = std::chrono::steady_clock::now();
+    for (int f = 0; f < BENCH_FRAMES; f++)
+        Servo::updateAll();
+    double idle = perFrame(start);
+    printf("updateAll() with 16 watched servos and one write: %.1f ns per frame; idle: %.1f ns\n", watched, idle);
+}
+
+int main()
+{
+    checkDeadlines();
+    checkSafeRamp();
+    checkDetach(40);
+    checkDetach(100);
+    bench();
+    printf("%ld failures\n", failures);
+    return ((failures == 0) ? 0 : 1);
+}
@@ -47,10 +47,55 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 * The servo signal pins connect to any available GPIO pins on the ESP32, but not all pins are
 * GPIO pins.
 *
-* The ESP32 is a 32 bit processor that includes FP support; this code reflects that fact.
+* The ESP32 is a 32 bit processor that includes FP support, but the tick conversions use
+* integer arithmetic (servoUsToTicks()/servoTicksToUs() in ESP32_Servo.h) so that tables
+* computed ahead of time, or at compile time, produce exactly the ticks write() would.
+* min and max are also kept in ticks, converted whenever they or the timer width change, so
+* writeTicks() and ServoGroup::stageTicks() clamp with two compares and no conversion.
+*
+* Backlash compensation: gear trains and potentiometer deadband make a servo stop
+* short of the commanded position by an amount that depends on the direction it came
+* from. writeMicroseconds() (and ServoGroup::stageMicroseconds()) remember the last
+* commanded width and the direction of travel, and add the calibrated offset for that
+* direction. The direction only changes when the command does, so repeated writes of
+* the same value keep the same offset instead of dithering. Raw tick writes are not
+* compensated, since they are expected to come from tables that already are. The group
+* compensates at commit(), once a frame has passed its constraints, with backlash(),
+* which changes nothing, and then track() for the values actually written, so a
+* rejected or dropped frame leaves the direction of travel where it was.
+*
+* Soft start: the position of an unpowered servo is unknown, so there is no way to ramp
+* the pulse width from "where it is" to the target, and a narrow pulse is itself a
+* position command. Instead, a soft-started channel is driven with a duty of 0 (no
+* pulse at all) and the pulses at the target width are gated in, a few frames at first
+* and then more each frame, with a Bresenham style accumulator: in frame k of n a pulse
+* is sent k/n of the time. A servo only drives its motor for a while after each pulse,
+* so the average torque ramps up with the pulse density. Every write goes through
+* output(), which leaves the channel alone while the gate owns it; updateAll() walks
+* only the channels in SoftStartMask, so it costs nothing once the ramps are done.
+*
+* Command watchdog: a write stores the frame at which the channel times out and sets
+* the channel's bit in one bucket of a timing wheel (WatchdogWheel, indexed by the
+* deadline modulo its size), moving it out of the bucket it was in. updateAll() then
+* looks only at the bucket for the current frame, so the per-frame cost does not grow
+* with the number of channels being watched, and a write costs two mask operations.
+* A timeout longer than the wheel just means the channel is looked at (and left in
+* place) once per turn of the wheel before it is due. Failsafe moves are written with
+* drive(), which does not feed the watchdog; any write from the application does, and
+* ends the failsafe move. The wheel and FailsafeMask are indexed by channel, and a
+* detached servo's channel may have been taken by another servo since, so only an
+* attached servo touches them; one that is not starts its deadline at its first write.
+*
+* Rate limiting: the LEDC only latches a new duty at the start of a PWM period, so of
+* several writes within one period only the last is ever seen by the servo, and the
+* others are wasted HAL calls. With a rate limit, send() writes the channel if the
+* period has passed since the last channel write, and otherwise only marks the channel
+* in RatePendingMask; the ticks field already holds the latest value, so whatever sends
+* it next (a later write, or updateAll()) sends the newest one.
 */
 
 #include "ESP32_Servo.h"
+#include "ServoMath.h"
 #include "esp32-hal-ledc.h"
 #include "Arduino.h"
 
@@ -61,45 +106,67 @@ int Servo::ServoCount = 0;
 // (i.e., available for reuse)
 int Servo::ChannelUsed[MAX_SERVOS+1] = {0}; // we ignore the zeroth element
 
-Servo::Servo()
+// The Registry array points at the Servo instance that owns each channel, so that
+// operations on all servos need no bookkeeping by the application (or any allocation).
+// Servo cannot be copied, so a channel has one owner at a time.
+Servo *Servo::Registry[MAX_SERVOS+1] = {0}; // we ignore the zeroth element
+
+uint32_t Servo::SoftStartMask = 0;
+
+uint32_t Servo::Frame = 0;
+uint32_t Servo::WatchdogWheel[SERVO_WATCHDOG_WHEEL] = {0};
+uint32_t Servo::FailsafeMask = 0;
+uint32_t Servo::RatePendingMask = 0;
+
+int Servo::claimChannel()
 {
-    this->servoChannel = 0;
     // see if there is a servo channel available for reuse
-    bool foundChannelForReuse = false;
     for (int i = 1; i < MAX_SERVOS+1; i++)
     {
         if (ChannelUsed[i] == -1)
         {
             // reclaim this channel
             ChannelUsed[i] = 1;
-            this->servoChannel = i;
-            foundChannelForReuse = true;
-            break;
+            return i;
         }
     }
-    if (!foundChannelForReuse)
+    // no channels available for reuse; get a new one if we can
+    if (ServoCount < MAX_SERVOS)
     {
-        // no channels available for reuse; get a new one if we can
-        if (ServoCount < MAX_SERVOS)
-        {
-            this->servoChannel = ++ServoCount;   // assign a servo channel number to this instance
-            ChannelUsed[this->servoChannel] = 1;
-        }
-        else 
-        {
-            this->servoChannel = 0;  // too many servos in use
-        }
+        ++ServoCount;
+        ChannelUsed[ServoCount] = 1;
+        return ServoCount;
     }
-    // if we got a channel either way, finish initializing it
+    return 0;  // too many servos in use
+}
+
+Servo::Servo()
+{
+    this->servoChannel = claimChannel();
+    this->pinNumber = -1;     // make it clear that we haven't attached a pin to this channel 
+    // if we got a channel, finish initializing it
     if (this->servoChannel > 0)
     {            
         // initialize this channel with plausible values, except pin # (we set pin # when attached)
         this->ticks = DEFAULT_PULSE_WIDTH_TICKS;   
         this->timer_width = DEFAULT_TIMER_WIDTH;
-        this->pinNumber = -1;     // make it clear that we haven't attached a pin to this channel 
         this->min = DEFAULT_uS_LOW;
         this->max = DEFAULT_uS_HIGH;
+        this->minTicks = usToTicks(this->min);
+        this->maxTicks = usToTicks(this->max);
         this->timer_width_ticks = pow(2,this->timer_width);
+        Registry[this->servoChannel] = this;
+    }
+}
+
+Servo::~Servo()
+{
+    // not if another servo took the channel while this one was detached
+    if ((this->servoChannel > 0) && (Registry[this->servoChannel] == this))
+    {
+        this->detach();
+        Registry[this->servoChannel] = 0;
+        ChannelUsed[this->servoChannel] = -1;
     }
 }
 
@@ -110,6 +177,13 @@ int Servo::attach(int pin)
 
 int Servo::attach(int pin, int min, int max)
 {    
+    if (this->servoChannel == 0)
+    {
+        // every channel was in use when this servo was constructed; try again
+        this->servoChannel = claimChannel();
+        if (this->servoChannel > 0)
+            Registry[this->servoChannel] = this;
+    }
     if ((this->servoChannel <= MAX_SERVOS) && (this->servoChannel > 0))
     { 
         // Recommend only the following pins 2,4,12-19,21-23,25-27,32-33 (enforcement commented out)
@@ -117,13 +191,29 @@ int Servo::attach(int pin, int min, int max)
         //        ((pin >= 25) && (pin <= 27)) || (pin == 32) || (pin == 33))
         //{
             // OK to proceed; first check for new/reuse
+            bool reattach = (this->pinNumber >= 0);
             if (this->pinNumber < 0) // we are attaching to a new or previously detached pin; we need to initialize/reinitialize
             {
-                // claim/reclaim this channel
+                // claim/reclaim this channel, unless another servo took it while we were detached
+                if ((Registry[this->servoChannel] != 0) && (Registry[this->servoChannel] != this))
+                {
+                    this->servoChannel = claimChannel();
+                    if (this->servoChannel == 0)
+                        return 0;
+                }
                 ChannelUsed[this->servoChannel] = 1;
-                this->ticks = DEFAULT_PULSE_WIDTH_TICKS;
-                this->timer_width = DEFAULT_TIMER_WIDTH;
-                this->timer_width_ticks = pow(2,this->timer_width);
+                Registry[this->servoChannel] = this;
+                // keep the timer width (see setTimerWidth())
+                this->ticks = usToTicks(DEFAULT_PULSE_WIDTH);
+                this->lastCommand = -1;     // the direction of travel is unknown again
+                this->direction = 0;
+                if (this->softStartFrames > 0)
+                {
+                    this->softStartCount = 0;     // no pulses until the first write
+                    this->softStartAccum = 0;
+                    this->softStartTarget = false;
+                    SoftStartMask |= (1UL << this->servoChannel);
+                }
             }
             this->pinNumber = pin;
         //}
@@ -139,10 +229,21 @@ int Servo::attach(int pin, int min, int max)
             max = MAX_PULSE_WIDTH;
         this->min = min;     //store this value in uS
         this->max = max;    //store this value in uS
+        this->minTicks = usToTicks(min);
+        this->maxTicks = usToTicks(max);
         // Set up this channel
         // if you want anything other than default timer width, you must call setTimerWidth() before attach
         ledcSetup(this->servoChannel, REFRESH_CPS, this->timer_width); // channel #, 50 Hz, timer width
         ledcAttachPin(this->pinNumber, this->servoChannel);   // GPIO pin assigned to channel        
+        if (this->softStartCount >= 0)
+            ledcWrite(this->servoChannel, 0);                 // hold the line low until the gate opens
+        else if (reattach)
+        {
+            // attaching the pin again set the duty to 0; stay where we were, within the new limits
+            this->drive((this->ticks < this->minTicks) ? this->minTicks :
+                        ((this->ticks > this->maxTicks) ? this->maxTicks : this->ticks));
+        }
+        return (this->servoChannel);
     }
     else return 0;  
 }
@@ -155,22 +256,18 @@ void Servo::detach()
         //keep track of detached servos channels so we can reuse them if needed
         ChannelUsed[this->servoChannel] = -1;
         this->pinNumber = -1;
+        this->softStartCount = -1;
+        SoftStartMask &= ~(1UL << this->servoChannel);
+        WatchdogWheel[this->watchdogDeadline & (SERVO_WATCHDOG_WHEEL-1)] &= ~(1UL << this->servoChannel);
+        FailsafeMask &= ~(1UL << this->servoChannel);
+        RatePendingMask &= ~(1UL << this->servoChannel);
     }
 }
 
 void Servo::write(int value)
 {
     // treat values less than MIN_PULSE_WIDTH (500) as angles in degrees (valid values in microseconds are handled as microseconds)
-    if (value < MIN_PULSE_WIDTH)
-    {
-        if (value < 0)
-            value = 0;
-        else if (value > 180)
-            value = 180;
-
-        value = map(value, 0, 180, this->min, this->max);
-    }
-    this->writeMicroseconds(value);
+    this->writeMicroseconds(servoAngleToUs(value, this->min, this->max));
 }
 
 void Servo::writeMicroseconds(int value)
@@ -183,16 +280,18 @@ void Servo::writeMicroseconds(int value)
         else if (value > this->max)
             value = this->max;
 
-        value = usToTicks(value);  // convert to ticks
-        this->ticks = value;
+        value = usToTicks(this->compensate(value));  // convert to ticks
         // do the actual write
-        ledcWrite(this->servoChannel, this->ticks);
+        this->output(value);
     }
 }
 
 int Servo::read() // return the value as degrees
 {
-    return (map(readMicroseconds()+1, this->min, this->max, 0, 180));
+    if (!this->attached() || (this->max <= this->min))
+        return 0;
+    // rounded, since write() truncates when it maps degrees to microseconds
+    return (((readMicroseconds() - this->min) * 180 + (this->max - this->min) / 2) / (this->max - this->min));
 }
 
 int Servo::readMicroseconds()
@@ -212,7 +311,8 @@ int Servo::readMicroseconds()
 
 bool Servo::attached()
 {
-    return (ChannelUsed[this->servoChannel]);
+    // ChannelUsed[] says whether the channel is owned, not whether a pin is attached to it
+    return ((this->servoChannel > 0) && (this->pinNumber >= 0));
 }
 
 void Servo::setTimerWidth(int value)
@@ -225,19 +325,21 @@ void Servo::setTimerWidth(int value)
         
     // Fix the current ticks value after timer width change
     // The user can reset the tick value with a write() or writeUs()
-    int widthDifference = this->timer_width - value;
-    // if positive multiply by diff; if neg, divide
+    int widthDifference = value - this->timer_width;
+    // if wider, multiply by 2**diff; if narrower, divide
     if (widthDifference > 0)
     {
-        this->ticks << widthDifference;
+        this->ticks <<= widthDifference;
     }
     else
     {
-        this->ticks >> widthDifference;
+        this->ticks >>= -widthDifference;
     }
     
     this->timer_width = value;
     this->timer_width_ticks = pow(2,this->timer_width);
+    this->minTicks = usToTicks(this->min);
+    this->maxTicks = usToTicks(this->max);
     
     // If this is an attached servo, clean up
     if ((this->servoChannel <= MAX_SERVOS) && (this->attached()))
@@ -246,6 +348,17 @@ void Servo::setTimerWidth(int value)
         ledcDetachPin(this->pinNumber);
         ledcSetup(this->servoChannel, REFRESH_CPS, this->timer_width);
         ledcAttachPin(this->pinNumber, this->servoChannel);
+        // the new setup starts with a duty of 0; put the pulse back now, rate limit or not
+        if ((this->softStartCount >= 0) && !this->softStartTarget)
+        {
+            ledcWrite(this->servoChannel, 0);             // nothing written yet: keep the line low
+        }
+        else
+        {
+            ledcWrite(this->servoChannel, this->ticks);   // a soft start gate carries on from updateAll()
+            RatePendingMask &= ~(1UL << this->servoChannel);
+            this->lastSendUsec = micros();
+        }
     }        
 }
 
@@ -254,14 +367,334 @@ int Servo::readTimerWidth()
     return (this->timer_width);
 }
 
+void Servo::writeTicks(int value)
+{
+    if ((this->servoChannel <= MAX_SERVOS) && (this->attached()))   // ensure channel is valid
+    {
+        if (value < this->minTicks)          // ensure pulse width is valid
+            value = this->minTicks;
+        else if (value > this->maxTicks)
+            value = this->maxTicks;
+
+        this->output(value);
+    }
+}
+
+int Servo::readTicks()
+{
+    return (this->ticks);
+}
+
+int Servo::readMin()
+{
+    return (this->min);
+}
+
+int Servo::readMax()
+{
+    return (this->max);
+}
+
+int Servo::readChannel()
+{
+    return (this->servoChannel);
+}
+
+Servo *Servo::fromChannel(int channel)
+{
+    if ((channel <= 0) || (channel > MAX_SERVOS))
+        return 0;
+    return (Registry[channel]);
+}
+
+void Servo::forEach(void (*function)(Servo &servo, void *context), void *context)
+{
+    for (int i = 1; i <= ServoCount; i++)
+    {
+        if (Registry[i] != 0)
+            function(*Registry[i], context);
+    }
+}
+
+void Servo::detachAll()
+{
+    for (int i = 1; i <= ServoCount; i++)
+    {
+        if (Registry[i] != 0)
+            Registry[i]->detach();
+    }
+}
+
+void Servo::snapshotAll(ServoSnapshot &snapshot)
+{
+    snapshot.attachedMask = 0;
+    snapshot.ticks[0] = 0;
+    for (int i = 1; i <= MAX_SERVOS; i++)
+    {
+        Servo *servo = Registry[i];
+        if ((i <= ServoCount) && (servo != 0) && servo->attached())
+        {
+            snapshot.attachedMask |= (1UL << i);
+            snapshot.ticks[i] = servo->ticks;
+        }
+        else
+        {
+            snapshot.ticks[i] = 0;
+        }
+    }
+}
+
+void Servo::restoreAll(const ServoSnapshot &snapshot)
+{
+    for (int i = 1; i <= ServoCount; i++)
+    {
+        Servo *servo = Registry[i];
+        if ((snapshot.attachedMask & (1UL << i)) && (servo != 0) && servo->attached())
+        {
+            // the snapshot was taken from these servos, so the limits already hold
+            servo->output(snapshot.ticks[i]);
+        }
+    }
+}
+
+void Servo::setBacklash(int up, int down)
+{
+    this->backlashUp = (up > 0) ? up : 0;
+    this->backlashDown = (down > 0) ? down : 0;
+}
+
+int Servo::readBacklashUp()
+{
+    return (this->backlashUp);
+}
+
+int Servo::readBacklashDown()
+{
+    return (this->backlashDown);
+}
+
+int Servo::compensate(int value)
+{
+    int result = this->backlash(value);
+    this->track(value);
+    return (result);
+}
+
+int Servo::backlash(int value)
+{
+    int towards = this->direction;
+    if (this->lastCommand >= 0)
+    {
+        if (value > this->lastCommand)
+            towards = 1;
+        else if (value < this->lastCommand)
+            towards = -1;
+    }
+    if (towards > 0)
+        value += this->backlashUp;
+    else if (towards < 0)
+        value -= this->backlashDown;
+    if (value < this->min)          // the offset never takes the servo past its limits
+        value = this->min;
+    else if (value > this->max)
+        value = this->max;
+    return (value);
+}
+
+void Servo::track(int value)
+{
+    if (this->lastCommand >= 0)
+    {
+        if (value > this->lastCommand)
+            this->direction = 1;
+        else if (value < this->lastCommand)
+            this->direction = -1;
+    }
+    this->lastCommand = value;
+}
+
+void Servo::setSoftStart(int frames)
+{
+    this->softStartFrames = (frames > 0) ? frames : 0;
+}
+
+bool Servo::softStarting()
+{
+    return (this->softStartCount >= 0);
+}
+
+void Servo::setWatchdog(int frames, int action, int safeUs, int speed)
+{
+    this->watchdogFrames = (frames > 0) ? frames : 0;
+    this->watchdogAction = action;
+    this->safeUs = safeUs;
+    this->safeSpeed = (speed > 0) ? speed : 0;
+    this->watchdogFired = false;
+    // a detached servo's channel may belong to another servo by now; its bits are not ours
+    if (!this->attached() || (Registry[this->servoChannel] != this))
+        return;
+    WatchdogWheel[this->watchdogDeadline & (SERVO_WATCHDOG_WHEEL-1)] &= ~(1UL << this->servoChannel);
+    FailsafeMask &= ~(1UL << this->servoChannel);
+    this->feedWatchdog();
+}
+
+void Servo::feedWatchdog()
+{
+    this->watchdogFired = false;
+    if ((this->watchdogFrames == 0) || !this->attached() || (Registry[this->servoChannel] != this))
+        return;
+    uint32_t bit = 1UL << this->servoChannel;
+    WatchdogWheel[this->watchdogDeadline & (SERVO_WATCHDOG_WHEEL-1)] &= ~bit;
+    FailsafeMask &= ~bit;
+    this->watchdogDeadline = Frame + this->watchdogFrames;
+    WatchdogWheel[this->watchdogDeadline & (SERVO_WATCHDOG_WHEEL-1)] |= bit;
+}
+
+bool Servo::timedOut()
+{
+    return (this->watchdogFired);
+}
+
+void Servo::updateAll()
+{
+    uint32_t pending = SoftStartMask;
+    for (int i = 0; pending != 0; i++, pending >>= 1)
+    {
+        if ((pending & 1) && (Registry[i] != 0))
+            Registry[i]->softStartStep();
+    }
+
+    Frame++;
+    uint32_t *bucket = &WatchdogWheel[Frame & (SERVO_WATCHDOG_WHEEL-1)];
+    pending = *bucket;
+    for (int i = 0; pending != 0; i++, pending >>= 1)
+    {
+        // a deadline more than one turn of the wheel away stays in its bucket
+        if ((pending & 1) && (Registry[i] != 0) && (Registry[i]->watchdogDeadline == Frame))
+        {
+            *bucket &= ~(1UL << i);
+            Registry[i]->failsafe();
+        }
+    }
+
+    pending = FailsafeMask;
+    for (int i = 0; pending != 0; i++, pending >>= 1)
+    {
+        if ((pending & 1) && (Registry[i] != 0))
+            Registry[i]->failsafeStep();
+    }
+
+    pending = RatePendingMask;
+    for (int i = 0; pending != 0; i++, pending >>= 1)
+    {
+        if ((pending & 1) && (Registry[i] != 0))
+            Registry[i]->send();
+    }
+}
+
+void Servo::output(int ticks)
+{
+    this->feedWatchdog();
+    this->drive(ticks);
+}
+
+void Servo::drive(int ticks)
+{
+    this->ticks = ticks;
+    if (this->softStartCount < 0)
+        this->send();
+    else
+        this->softStartTarget = true;   // the gate sends it from updateAll()
+}
+
+void Servo::setRateLimit(int usec)
+{
+    this->rateUsec = (usec > 0) ? usec : 0;
+    this->lastSendUsec = micros() - this->rateUsec;   // the next write goes out at once
+}
+
+void Servo::send()
+{
+    if (this->rateUsec != 0)
+    {
+        uint32_t now = micros();
+        if ((uint32_t)(now - this->lastSendUsec) < this->rateUsec)
+        {
+            RatePendingMask |= (1UL << this->servoChannel);
+            return;
+        }
+        this->lastSendUsec = now;
+        RatePendingMask &= ~(1UL << this->servoChannel);
+    }
+    ledcWrite(this->servoChannel, this->ticks);
+}
+
+void Servo::softStartStep()
+{
+    if (!this->softStartTarget)
+        return;                         // nothing to drive towards yet
+    this->softStartCount++;
+    if (this->softStartCount >= this->softStartFrames)
+    {
+        // ramp done; the channel is driven by every write again
+        this->softStartCount = -1;
+        SoftStartMask &= ~(1UL << this->servoChannel);
+        ledcWrite(this->servoChannel, this->ticks);
+        return;
+    }
+    this->softStartAccum += this->softStartCount;
+    if (this->softStartAccum >= this->softStartFrames)
+    {
+        this->softStartAccum -= this->softStartFrames;
+        ledcWrite(this->servoChannel, this->ticks);
+    }
+    else
+    {
+        ledcWrite(this->servoChannel, 0);
+    }
+}
+
+void Servo::failsafe()
+{
+    this->watchdogFired = true;
+    if (!this->attached())
+        return;
+    if (this->watchdogAction == SERVO_FAILSAFE_DETACH)
+        this->detach();
+    else if (this->watchdogAction == SERVO_FAILSAFE_SAFE)
+        FailsafeMask |= (1UL << this->servoChannel);   // the first step is taken this frame
+}
+
+void Servo::failsafeStep()
+{
+    int value = this->safeUs;
+    if (value < this->min)
+        value = this->min;
+    else if (value > this->max)
+        value = this->max;
+    int target = usToTicks(value);
+    int step = usToTicks(this->safeSpeed);
+    int remaining = target - this->ticks;
+    if ((this->safeSpeed == 0) || (remaining <= step && remaining >= -step))
+    {
+        FailsafeMask &= ~(1UL << this->servoChannel);
+        this->drive(target);
+    }
+    else
+    {
+        this->drive(this->ticks + ((remaining > 0) ? step : -step));
+    }
+}
+
+// integer arithmetic, so that precomputed tick tables match write() exactly
 int Servo::usToTicks(int usec)
 {
-    return (int)((float)usec / ((float)REFRESH_USEC / (float)this->timer_width_ticks));   
+    return servoUsToTicks(usec, this->timer_width);
 }
 
 int Servo::ticksToUs(int ticks)
 {
-    return (int)((float)ticks * ((float)REFRESH_USEC / (float)this->timer_width_ticks)); 
+    return servoTicksToUs(ticks, this->timer_width);
 }
 
  
\ No newline at end of file
@@ -31,7 +31,10 @@
     Servo - Class for manipulating servo motors connected to ESP32 pins.
     int attach(pin )  - Attaches the given GPIO pin to the next free channel
         (channels that have previously been detached are used first), 
-        returns channel number or 0 if failure. All pin numbers are allowed,
+        returns channel number or 0 if failure. A detached servo whose
+        channel has since been taken by another instance, or one constructed
+        while every channel was in use, gets a new one. Attaching an attached
+        servo again keeps its pulse width (within the new min and max). All pin numbers are allowed,
         but only pins 2,4,12-19,21-23,25-27,32-33 are recommended.
     int attach(pin, min, max  ) - Attaches to a pin setting min and max 
         values in microseconds; enforced minimum min is 500, enforced max
@@ -50,21 +53,77 @@
     
     void writeMicroseconds() - Sets the servo pulse width in microseconds.
         min and max are enforced (see above). 
-    int read() - Gets the last written servo pulse width as an angle between 0 and 180. 
-    int readMicroseconds()   - Gets the last written servo pulse width in microseconds.
-    bool attached() - Returns true if this servo instance is attached. 
+    int read() - Gets the last written servo pulse width as an angle between 0 and 180
+        (rounded, so an angle written is read back unchanged). 
+    int readMicroseconds()   - Gets the last written servo pulse width in microseconds
+        (a width written is read back unchanged); 0 if not attached.
+    bool attached() - Returns true if this servo instance is attached to a pin. 
     void detach() - Stops an the attached servo, frees its attached pin, and frees
         its channel for reuse). 
+    Servos are not copyable. Destroying a Servo (for example a local
+        that goes out of scope at the end of setup()) detaches it and frees
+        its channel, so servos that must keep running should be global or
+        static.
     
     *** ESP32-specific functions **
     setTimerWidth(value) - Sets the PWM timer width (must be 16-20) (ESP32 ONLY);
-        as a side effect, the pulse width is recomputed.
+        as a side effect, the pulse width is recomputed. The width is kept
+        by attach() and detach().
     int readTimerWidth() - Gets the PWM timer width (ESP32 ONLY) 
+    void writeTicks(value) - Sets the pulse width directly in timer ticks
+        (for precomputed motion data); min and max are enforced.
+    int readTicks() - Gets the current pulse width in timer ticks.
+    int readMin(), readMax() - Get the pulse width limits set by attach().
+    int readChannel() - Gets the PWM channel used by this servo.
+    void setBacklash(up, down) - Sets the backlash compensation in
+        microseconds: up is added to writes that move the servo towards max,
+        down is subtracted from writes that move it towards min (the result
+        stays within min and max). Both are 0 by default.
+    int readBacklashUp(), readBacklashDown() - Get the compensation values.
+    void setSoftStart(frames) - Enables soft start for the next attach()
+        (0, the default, disables it). A soft-started servo sends no pulses
+        until it is first written; then the pulses at the written width are
+        gated, from roughly one frame in frames up to every frame over frames
+        refresh periods, so a servo at an unknown position creeps to the
+        target instead of snapping to it at full torque. attach() returns at
+        once; updateAll() advances the ramp.
+    bool softStarting() - Returns true while the soft start ramp is running.
+    void setWatchdog(frames, action, safeUs, speed) - Enables the command
+        watchdog: if the servo is not written for frames refresh periods,
+        the failsafe action is taken (frames 0 disables it):
+            SERVO_FAILSAFE_HOLD    keep the last pulse width
+            SERVO_FAILSAFE_SAFE    move to safeUs (microseconds) at speed
+                                   microseconds per frame (0 at once)
+            SERVO_FAILSAFE_DETACH  stop the pulses and free the pin
+        Every write (including ServoGroup commits) resets the deadline. On
+        a servo that is not attached, the deadline starts at its first write
+        after attach().
+    void feedWatchdog() - Resets the deadline without writing (does nothing
+        to the deadline of a servo that is not attached).
+    bool timedOut() - True if the watchdog has fired since the last write.
+    void setRateLimit(usec) - Writes the PWM channel at most once every usec
+        microseconds (0, the default, writes every time). A write within
+        the period only updates the pulse width, which is sent when the
+        period is over, by the next write or by updateAll(); the latest
+        value always wins. REFRESH_USEC matches the pulse rate.
+
+    *** Operations on all servos (static) **
+    Servo *fromChannel(channel) - Gets the servo using a PWM channel.
+    forEach(function, context) - Calls function for every live servo.
+    detachAll() - Detaches every servo.
+    snapshotAll(snapshot) - Saves the pulse width of every servo.
+    restoreAll(snapshot) - Writes the saved pulse widths back to the servos
+        that were attached when the snapshot was taken and still are.
+    updateAll() - Advances per-frame work (soft start ramps, watchdogs,
+        failsafe moves and rate limited writes); call it once per refresh
+        period (REFRESH_USEC), e.g. from loop().
  */
  
 #ifndef ESP32_Servo_h
 #define ESP32_Servo_h
 
+#include <stdint.h>
+
 // Values for TowerPro MG995 large servos (and many other hobbyist servos)
 #define DEFAULT_uS_LOW 1000        // 1000us
 #define DEFAULT_uS_HIGH 2000      // 2000us
@@ -81,12 +140,32 @@
 #define MIN_PULSE_WIDTH       500     // the shortest pulse sent to a servo  
 #define MAX_PULSE_WIDTH      2500     // the longest pulse sent to a servo 
 #define DEFAULT_PULSE_WIDTH  1500     // default pulse width when servo is attached
-#define DEFAULT_PULSE_WIDTH_TICKS 4825
+#define DEFAULT_PULSE_WIDTH_TICKS 4915     // DEFAULT_PULSE_WIDTH at DEFAULT_TIMER_WIDTH
 #define REFRESH_CPS            50
 #define REFRESH_USEC         20000
 
 #define MAX_SERVOS              16     // no. of PWM channels in ESP32
 
+#define SERVO_FAILSAFE_HOLD      0     // watchdog actions (see setWatchdog())
+#define SERVO_FAILSAFE_SAFE      1
+#define SERVO_FAILSAFE_DETACH    2
+#define SERVO_WATCHDOG_WHEEL    32     // deadline buckets, a power of 2
+
+// Integer pulse width conversions for a given timer width. Servo uses these,
+// and they are constexpr so motion tables can be converted at compile time
+// with exactly the same results (see ServoChoreography.h).
+// refreshUsec is the PWM period; only offline converters need a value other than REFRESH_USEC.
+// Both round to nearest; a tick is shorter than a microsecond at any width Servo
+// allows, so microseconds -> ticks -> microseconds gives back the same value.
+constexpr int servoUsToTicks(int usec, int timerWidth, int refreshUsec = REFRESH_USEC)
+{
+  return (int)((((long long)usec << timerWidth) + refreshUsec / 2) / refreshUsec);
+}
+constexpr int servoTicksToUs(int ticks, int timerWidth, int refreshUsec = REFRESH_USEC)
+{
+  return (int)((((long long)ticks * refreshUsec) + (1LL << (timerWidth - 1))) >> timerWidth);
+}
+
 /*
 * This group/channel/timmer mapping is for information only;
 * the details are handled by lower-level code
@@ -110,10 +189,20 @@
 ** ledc: 15 => Group: 1, Channel: 7, Timer: 3
 */
 
+// pulse widths of every live servo, for Servo::snapshotAll()/restoreAll()
+struct ServoSnapshot
+{
+  uint32_t attachedMask;             // bit n set if channel n was attached
+  int ticks[MAX_SERVOS+1];           // indexed by channel; we ignore the zeroth element
+};
+
 class Servo
 {
 public:
   Servo();
+  ~Servo();                          // detaches and frees the channel
+  Servo(const Servo &) = delete;     // a copy would share the channel it frees
+  Servo &operator=(const Servo &) = delete;
   // Arduino Servo Library calls
   int attach(int pin);                   // attach the given pin to the next free channel, returns channel number or 0 if failure
   int attach(int pin, int min, int max); // as above but also sets min and max values for writes. 
@@ -127,18 +216,75 @@ public:
   // ESP32 only functions
   void setTimerWidth(int value);     // set the PWM timer width (ESP32 ONLY)
   int readTimerWidth();              // get the PWM timer width (ESP32 ONLY)  
+  void writeTicks(int value);        // write a raw pulse width in timer ticks; min and max are enforced
+  int readTicks();                   // get the current pulse width in timer ticks
+  int readMin();                     // get the minimum pulse width in microseconds (from attach)
+  int readMax();                     // get the maximum pulse width in microseconds (from attach)
+  int readChannel();                 // get the PWM channel of this servo (0 if none)
+  void setBacklash(int up, int down); // direction-aware offsets in microseconds, both >= 0
+  int readBacklashUp();
+  int readBacklashDown();
+  void setSoftStart(int frames);     // gated ramp length for the next attach(), in refresh periods; 0 = off
+  bool softStarting();               // true while the ramp is running
+  void setWatchdog(int frames, int action = SERVO_FAILSAFE_HOLD, int safeUs = DEFAULT_PULSE_WIDTH, int speed = 0);
+  void feedWatchdog();               // resets the deadline, as a write does
+  bool timedOut();                   // the watchdog fired and nothing has been written since
+  void setRateLimit(int usec);       // least time between two channel writes; 0 = no limit
+
+  // operations on every live servo (the registry is indexed by channel)
+  static Servo *fromChannel(int channel);                    // the servo using channel, or 0
+  static void forEach(void (*function)(Servo &servo, void *context), void *context);
+  static void detachAll();
+  static void snapshotAll(ServoSnapshot &snapshot);
+  static void restoreAll(const ServoSnapshot &snapshot);     // rewrites attached servos only
+  static void updateAll();                                   // once per refresh period
 
   private: 
+   friend class ServoGroup;                           // ServoGroup commits ticks directly
    int usToTicks(int usec);
+   static int claimChannel();                         // takes a free channel; 0 if none
    int ticksToUs(int ticks);
+   int compensate(int value);                         // applies backlash to a clamped pulse width
+   int backlash(int value);                           // what compensate() would return, changing nothing
+   void track(int value);                             // records value as the last command, for the direction
+   void output(int ticks);                            // a write: feeds the watchdog, then drive()
+   void drive(int ticks);                             // sets ticks and drives the channel (or the gate)
+   void send();                                       // ledcWrite(), subject to the rate limit
+   void softStartStep();
+   void failsafe();                                   // the watchdog fired
+   void failsafeStep();                               // one frame of the move to the safe pose
+   static uint32_t Frame;                             // updateAll() calls so far
+   static uint32_t WatchdogWheel[];                   // bit n of bucket d set if channel n's deadline is d (mod size)
+   static uint32_t FailsafeMask;                      // bit n set while channel n moves to its safe pose
+   static uint32_t RatePendingMask;                   // bit n set if channel n holds back a rate limited write
    static int ServoCount;                             // the total number of attached servos
    static int ChannelUsed[];                          // used to track whether a channel is in service
+   static Servo *Registry[];                          // live servo on each channel, or 0
+   static uint32_t SoftStartMask;                     // bit n set while channel n is soft starting
    int servoChannel = 0;                              // channel number for this servo
    int min = DEFAULT_uS_LOW;                          // minimum pulse width for this servo   
    int max = DEFAULT_uS_HIGH;                         // maximum pulse width for this servo 
+   int minTicks = servoUsToTicks(DEFAULT_uS_LOW, DEFAULT_TIMER_WIDTH);   // min in ticks, set with min and timer_width
+   int maxTicks = servoUsToTicks(DEFAULT_uS_HIGH, DEFAULT_TIMER_WIDTH);  // max in ticks, likewise
    int pinNumber = 0;                                 // GPIO pin assigned to this channel
    int timer_width = DEFAULT_TIMER_WIDTH;             // ESP32 allows variable width PWM timers
    int ticks = DEFAULT_PULSE_WIDTH_TICKS;             // current pulse width on this channel
    int timer_width_ticks = DEFAULT_TIMER_WIDTH_TICKS; // no. of ticks at rollover; varies with width
+   int backlashUp = 0;                                // added when moving towards max (us)
+   int backlashDown = 0;                              // subtracted when moving towards min (us)
+   int lastCommand = -1;                              // last uncompensated pulse width, -1 if none
+   int direction = 0;                                 // +1 towards max, -1 towards min, 0 not yet moved
+   int softStartFrames = 0;                           // ramp length in refresh periods, 0 = off
+   int softStartCount = -1;                           // frames into the ramp, -1 when not soft starting
+   int softStartAccum = 0;                            // gate accumulator; a pulse is sent when it wraps
+   bool softStartTarget = false;                      // a width has been written since attach()
+   int watchdogFrames = 0;                            // command timeout in refresh periods, 0 = off
+   uint32_t watchdogDeadline = 0;                     // Frame at which the watchdog fires
+   uint8_t watchdogAction = SERVO_FAILSAFE_HOLD;
+   bool watchdogFired = false;
+   int safeUs = DEFAULT_PULSE_WIDTH;                  // failsafe pose and speed (microseconds)
+   int safeSpeed = 0;
+   uint32_t rateUsec = 0;                             // least time between channel writes, 0 = off
+   uint32_t lastSendUsec = 0;                         // micros() at the last channel write
 };
 #endif
@@ -0,0 +1,308 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The solution is the usual one for two links of lengths l1 and l2 with
+* the tool at distance d from the shoulder: the cosine of the elbow angle
+* is c = (d*d - l1*l1 - l2*l2) / (2*l1*l2), its sine s = +-sqrt(1 - c*c),
+* the elbow angle atan2(s, c), and the shoulder angle the direction of the
+* tool less atan2(l2*s, l1 + l2*c). c and s are 2.30 fixed point, so the
+* only operations are one division, one square root (servoSqrt()) and the
+* atan2s.
+* servoAtan2() is CORDIC in vectoring mode: the vector is scaled up to 31
+* bits, then rotated towards the x axis by +-atan(2**-i) for 24 steps,
+* adding up the rotations in binary angles, where a turn is 2**32 and
+* angles wrap the way unsigned arithmetic does (sums and differences of
+* them are taken in uint32_t, then read as signed). The result is good to about
+* 1e-6 of a turn, far below what a servo resolves.
+* Joints are written in ticks, computed from the angle in 24.8 fixed point
+* microseconds, so at a 16 bit timer width a joint moves in steps of 0.3
+* microseconds rather than 1. A point that needs a joint past its servo's
+* min or max is out of reach, like one too far from the shoulder, so a
+* move stops there rather than bending the path against a clamped joint;
+* backlash compensation is not applied.
+* The clock of a move counts frames in 24.8 fixed point and advances by
+* the supply scale, as ServoController's eased moves do, so a sagging
+* supply slows the tool down along the same line and easing.
+*/
+
+#include "ServoArm.h"
+#include "ServoMath.h"
+
+#define SERVO_ARM_CORDIC_STEPS   24
+
+// atan(2**-i) in binary angles
+static const int32_t cordicAngles[SERVO_ARM_CORDIC_STEPS] = {
+    536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838, 5340245,
+    2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861,
+    10430, 5215, 2608, 1304, 652, 326, 163, 81
+};
+
+int32_t servoAtan2(int64_t y, int64_t x)
+{
+    if ((x == 0) && (y == 0))
+        return 0;
+    uint32_t angle = 0;
+    if (x < 0)
+    {
+        x = -x;                     // turn half way round, into the right half plane
+        y = -y;
+        angle = 0x80000000UL;
+    }
+    int64_t size = (x > ((y < 0) ? -y : y)) ? x : ((y < 0) ? -y : y);
+    while (size >= (1LL << 31))
+    {
+        size /= 2;
+        x /= 2;
+        y /= 2;
+    }
+    while (size < (1LL << 30))
+    {
+        size *= 2;
+        x *= 2;
+        y *= 2;
+    }
+    for (int i = 0; i < SERVO_ARM_CORDIC_STEPS; i++)
+    {
+        int64_t dx = x >> i;
+        int64_t dy = y >> i;
+        if (y > 0)
+        {
+            x += dy;
+            y -= dx;
+            angle += cordicAngles[i];
+        }
+        else
+        {
+            x -= dy;
+            y += dx;
+            angle -= cordicAngles[i];
+        }
+    }
+    return ((int32_t)angle);
+}
+
+ServoArm::ServoArm(ServoGroup &group, int geometry)
+{
+    this->group = &group;
+    this->geometry = geometry;
+    for (int j = 0; j < SERVO_ARM_JOINTS; j++)
+    {
+        this->joint[j] = -1;
+        this->zeroUs[j] = DEFAULT_PULSE_WIDTH;
+        this->usPer90[j] = 1000;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        this->position[i] = 0;
+        this->start[i] = 0;
+        this->target[i] = 0;
+    }
+}
+
+void ServoArm::setLinks(int upper, int lower)
+{
+    this->upper = (upper < 1) ? 1 : ((upper > 30000) ? 30000 : upper);
+    this->lower = (lower < 1) ? 1 : ((lower > 30000) ? 30000 : lower);
+}
+
+void ServoArm::setJoint(int joint, int index, int zeroUs, int usPer90)
+{
+    if ((joint < 0) || (joint >= SERVO_ARM_JOINTS))
+        return;
+    this->joint[joint] = ((index >= 0) && (index < this->group->count())) ? index : -1;
+    this->zeroUs[joint] = zeroUs;
+    this->usPer90[joint] = usPer90;
+}
+
+void ServoArm::setElbowUp(bool up)
+{
+    this->elbowUp = up;
+}
+
+bool ServoArm::solve(long x, long y, long z, int *ticks)
+{
+    int32_t angles[SERVO_ARM_JOINTS];
+    int64_t r;                      // in the plane of the links: distance out, and height
+    int64_t h;
+    if (this->geometry == SERVO_ARM_YAW)
+    {
+        angles[SERVO_ARM_BASE] = servoAtan2(y, x);
+        r = servoSqrt((int64_t)x * x + (int64_t)y * y);
+        h = z;
+    }
+    else
+    {
+        angles[SERVO_ARM_BASE] = 0;
+        r = x;
+        h = y;
+    }
+    int64_t l1 = this->upper;
+    int64_t l2 = this->lower;
+    int64_t span = 2 * l1 * l2;
+    int64_t excess = r * r + h * h - l1 * l1 - l2 * l2;
+    if ((excess > span) || (excess < -span))
+        return false;
+    int64_t c = (excess << 30) / span;                      // 2.30
+    int64_t s = servoSqrt((1LL << 60) - c * c);
+    if (this->elbowUp)
+        s = -s;
+    angles[SERVO_ARM_ELBOW] = servoAtan2(s, c);
+    // binary angles wrap: past half a turn, a signed difference would overflow
+    angles[SERVO_ARM_SHOULDER] = (int32_t)((uint32_t)servoAtan2(h, r) - (uint32_t)servoAtan2(l2 * s, (l1 << 30) + l2 * c));
+
+    for (int j = 0; j < SERVO_ARM_JOINTS; j++)
+    {
+        int index = this->joint[j];
+        if (index < 0)
+            continue;
+        // angle (2**30 per 90 degrees) to 24.8 microseconds, then to ticks
+        Servo *servo = this->group->servo(index);
+        int64_t us = ((int64_t)this->zeroUs[j] << 8) + (((int64_t)angles[j] * this->usPer90[j]) >> 22);
+        if ((us < ((int64_t)servo->readMin() << 8)) || (us > ((int64_t)servo->readMax() << 8)))
+            return false;           // past the joint's range
+        int width = servo->readTimerWidth();
+        int64_t period = (int64_t)REFRESH_USEC << 8;
+        ticks[j] = (int)(((us << width) + period / 2) / period);
+    }
+    return true;
+}
+
+bool ServoArm::reachable(long x, long y, long z)
+{
+    int ticks[SERVO_ARM_JOINTS];
+    return (this->solve(x, y, z, ticks));
+}
+
+bool ServoArm::put(long x, long y, long z)
+{
+    int ticks[SERVO_ARM_JOINTS];
+    if (!this->solve(x, y, z, ticks))
+        return false;
+    for (int j = 0; j < SERVO_ARM_JOINTS; j++)
+    {
+        if (this->joint[j] >= 0)
+            this->group->stageTicks(this->joint[j], ticks[j]);
+    }
+    this->group->commit();
+    this->position[0] = x;
+    this->position[1] = y;
+    this->position[2] = z;
+    return true;
+}
+
+bool ServoArm::begin(long x, long y, long z)
+{
+    this->isMoving = false;
+    this->isBlocked = false;
+    if (!this->put(x, y, z))
+        return false;
+    this->isPlaced = true;
+    return true;
+}
+
+bool ServoArm::moveTo(long x, long y, long z, int speed, int easing)
+{
+    // a move starts where the tool is, which is not known until begin()
+    if (!this->isPlaced || !this->reachable(x, y, z))
+        return false;
+    int64_t length = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        this->start[i] = this->position[i];
+        int64_t d = ((i == 0) ? x : ((i == 1) ? y : z)) - this->position[i];
+        length += d * d;
+    }
+    this->target[0] = x;
+    this->target[1] = y;
+    this->target[2] = z;
+    length = servoSqrt(length);
+    this->frames = (speed > 0) ? (int32_t)((length + speed - 1) / speed) : 1;
+    if (this->frames < 1)
+        this->frames = 1;
+    else if (this->frames > 0x7FFFFF)
+        this->frames = 0x7FFFFF;        // the clock of the move is 24.8
+    this->frame = 0;
+    this->easing = easing;
+    this->isMoving = true;
+    this->isBlocked = false;
+    return true;
+}
+
+bool ServoArm::moving()
+{
+    return (this->isMoving);
+}
+
+bool ServoArm::blocked()
+{
+    return (this->isBlocked);
+}
+
+long ServoArm::readX()
+{
+    return (this->position[0]);
+}
+
+long ServoArm::readY()
+{
+    return (this->position[1]);
+}
+
+long ServoArm::readZ()
+{
+    return (this->position[2]);
+}
+
+void ServoArm::setSupply(ServoSupply *supply)
+{
+    this->supply = supply;
+}
+
+void ServoArm::update()
+{
+    if (!this->isMoving)
+        return;
+    // a low supply slows the clock of the move; a critical one holds it
+    int scale = this->supply ? this->supply->readScale() : SERVO_SUPPLY_SCALE_ONE;
+    if (scale <= 0)
+        return;
+    this->frame += scale;
+    bool done = (this->frame >= (this->frames << 8));
+    long point[3];
+    if (done)
+    {
+        for (int i = 0; i < 3; i++)
+            point[i] = this->target[i];
+    }
+    else
+    {
+        long fraction = servoEase(this->easing, ((int64_t)this->frame << 8) / this->frames);
+        for (int i = 0; i < 3; i++)
+            point[i] = this->start[i] + (long)(((int64_t)(this->target[i] - this->start[i]) * fraction) >> 16);
+    }
+    if (!this->put(point[0], point[1], point[2]))
+    {
+        // the line passes inside (or an overshooting curve outside) the arm's reach,
+        // or needs a joint past its range
+        this->isMoving = false;
+        this->isBlocked = true;
+        return;
+    }
+    if (done)
+        this->isMoving = false;
+}
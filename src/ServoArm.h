@@ -0,0 +1,141 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoArm.h - Straight line moves of an arm's tool, solved per frame
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A ServoArm moves the tool at the end of a two link arm along straight
+  lines. Every frame, update() takes the next point on the line, solves
+  the joint angles for it (inverse kinematics, in integer arithmetic) and
+  writes the joint servos of a ServoGroup in one commit, in timer ticks
+  rather than whole microseconds.
+
+  Two geometries are supported:
+
+    SERVO_ARM_PLANAR - Shoulder and elbow joints turning in the x-y plane,
+        with the shoulder at the origin (z is ignored).
+    SERVO_ARM_YAW - A base joint turning about the z axis, then shoulder
+        and elbow joints turning in the vertical plane through it; the
+        shoulder is at the origin.
+
+  The shoulder angle is measured from the x axis (SERVO_ARM_PLANAR) or the
+  horizontal (SERVO_ARM_YAW), the elbow angle from the line of the upper
+  link, and the base angle from the x axis, all counterclockwise. A joint
+  servo is at zeroUs at angle 0 and moves usPer90 microseconds (negative
+  if it turns the other way) per 90 degrees.
+
+  Coordinates and lengths are in 0.1 mm, links up to 3 m.
+
+  The class methods are:
+
+    ServoArm(group, geometry) - Creates an arm whose joints are servos of
+        group.
+    void setLinks(upper, lower) - Sets the lengths of the upper link
+        (shoulder to elbow) and the lower link (elbow to tool).
+    void setJoint(joint, index, zeroUs, usPer90) - Assigns the servo at
+        index in the group to joint (SERVO_ARM_SHOULDER, SERVO_ARM_ELBOW
+        or SERVO_ARM_BASE) and sets its calibration.
+    void setElbowUp(up) - Chooses which of the two solutions to use; up
+        (the default) keeps the elbow above the line from the shoulder to
+        the tool.
+    bool reachable(x, y, z) - True if the tool can be at x, y, z: within
+        the links' reach, with every joint within its servo's min and max.
+    bool begin(x, y, z) - Puts the tool at x, y, z at once; false (and
+        nothing written) if it is out of reach. Required before the first
+        moveTo(), which starts from the tool's position.
+    bool moveTo(x, y, z, speed, easing) - Starts a straight line move to
+        x, y, z at speed (0.1 mm per frame; 0 moves in one frame), along
+        easing (a SERVO_EASE_* curve; see ServoEasing.h). Returns false if
+        the end is out of reach, or if begin() has not yet succeeded.
+    bool moving() - True while a move is in progress.
+    bool blocked() - True if the last move stopped at a point on the line
+        that was out of reach: too far from or too close to the shoulder,
+        or needing a joint past its servo's min or max.
+    long readX(), readY(), readZ() - Where the tool was last put.
+    void setSupply(supply) - Scales the speed of the moves by the supply
+        voltage, and holds a move where it is while the supply is critical
+        (see ServoSupply.h; 0 to stop).
+    void update() - Advances the move by one frame, solves the joints and
+        commits the group. Call this once per frame.
+
+  The functions are:
+
+    int32_t servoAtan2(y, x) - atan2 as a binary angle (2**32 per turn,
+        so 0x40000000 is 90 degrees).
+ */
+
+#ifndef ServoArm_h
+#define ServoArm_h
+
+#include <stdint.h>
+#include "ServoGroup.h"
+#include "ServoEasing.h"
+#include "ServoSupply.h"
+
+#define SERVO_ARM_PLANAR     0      // shoulder and elbow in the x-y plane
+#define SERVO_ARM_YAW        1      // base about z, then shoulder and elbow
+
+#define SERVO_ARM_SHOULDER   0
+#define SERVO_ARM_ELBOW      1
+#define SERVO_ARM_BASE       2
+#define SERVO_ARM_JOINTS     3
+
+class ServoArm
+{
+public:
+  ServoArm(ServoGroup &group, int geometry = SERVO_ARM_PLANAR);
+  void setLinks(int upper, int lower);
+  void setJoint(int joint, int index, int zeroUs, int usPer90);
+  void setElbowUp(bool up);
+  bool reachable(long x, long y, long z = 0);
+  bool begin(long x, long y, long z = 0);
+  bool moveTo(long x, long y, long z, int speed, int easing = SERVO_EASE_LINEAR);
+  bool moving();
+  bool blocked();
+  long readX();
+  long readY();
+  long readZ();
+  void setSupply(ServoSupply *supply);
+  void update();
+
+  private:
+   bool solve(long x, long y, long z, int *ticks);         // ticks per joint; false if out of reach
+   bool put(long x, long y, long z);                       // solves, stages and commits
+   ServoGroup *group;
+   ServoSupply *supply = 0;
+   int geometry;
+   int32_t upper = 1000;
+   int32_t lower = 1000;
+   bool elbowUp = true;
+   int8_t joint[SERVO_ARM_JOINTS];        // index in the group, or -1
+   int16_t zeroUs[SERVO_ARM_JOINTS];
+   int16_t usPer90[SERVO_ARM_JOINTS];
+   long position[3];                      // where the tool is
+   long start[3];                         // of the move
+   long target[3];
+   int easing = SERVO_EASE_LINEAR;
+   int32_t frames = 0;                    // in the move
+   int32_t frame = 0;                     // of the move, so far, 24.8 fixed point
+   bool isMoving = false;
+   bool isBlocked = false;
+   bool isPlaced = false;                 // begin() has put the tool somewhere
+};
+
+int32_t servoAtan2(int64_t y, int64_t x);
+
+#endif
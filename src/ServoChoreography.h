@@ -0,0 +1,168 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoChoreography.h - Compile-time motion sequences for ESP32 servos
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A fixed choreography is declared as a list of waypoints (pulse width in
+  microseconds, duration in frames, easing). servoCompileTrack() turns it
+  into one timer tick value per frame at compile time; declared constexpr
+  at file scope, the table is placed in flash (rodata) and playback needs
+  no RAM and no usToTicks()/map() conversions. Requires C++14.
+
+    constexpr ServoWaypoint wave[] = {
+        { 2000, 25, SERVO_EASE_IN_OUT },
+        { 1000, 50, SERVO_EASE_LINEAR },
+    };
+    constexpr auto waveTrack =
+        servoCompileTrack<DEFAULT_TIMER_WIDTH, servoTrackLength(wave)>(1500, wave, 1000, 2000);
+    static_assert(waveTrack.error == SERVO_TRACK_OK, "wave is invalid");
+
+    // in loop(), once per frame
+    servoPlayTrackFrame(myservo, waveTrack, frame++);
+
+  The ticks are those myservo.writeMicroseconds() puts on the channel for
+  the same eased pulse widths (servoEaseUs()) at the same timer width and
+  limits, and, for eased waypoints, those of a ServoController running the
+  waypoints as queueTimed() segments: the curves are servoEase()'s, and
+  the rounding is the controller's. extras/servo_check/choreography_check.cpp
+  checks both, frame by frame, on a host.
+
+  The functions are:
+
+    int servoTrackLength(waypoints) - Total frames in a waypoint list.
+    int servoEaseUs(fromUs, toUs, frame, frames, easing) - Pulse width at
+        frame (1..frames) of a move; usable at compile time or run time.
+    ServoTickTrack<Width, Frames> servoCompileTrack<Width, Frames>(startUs,
+        waypoints, minUs, maxUs) - Builds the tick table; error is not
+        SERVO_TRACK_OK if the limits are invalid, a waypoint is out of range,
+        a duration is not positive, or the lengths do not match.
+    bool servoPlayTrackFrame(servo, track, frame) - Writes the ticks for
+        frame; returns false when frame is past the end, or the servo timer
+        width does not match the track.
+ */
+
+#ifndef ServoChoreography_h
+#define ServoChoreography_h
+
+#if __cplusplus < 201402L
+#error "ServoChoreography.h requires C++14 (relaxed constexpr)"
+#endif
+
+#include <stdint.h>
+#include <type_traits>
+#include "ESP32_Servo.h"
+#include "ServoEasing.h"     // SERVO_EASE_* and servoEaseQuadratic(); tracks use the quadratic curves
+
+// servoCompileTrack() error codes
+#define SERVO_TRACK_OK        0
+#define SERVO_TRACK_LIMITS    1     // min/max outside MIN_PULSE_WIDTH - MAX_PULSE_WIDTH
+#define SERVO_TRACK_RANGE     2     // a waypoint (or the start) is outside min/max
+#define SERVO_TRACK_DURATION  3     // a waypoint has a duration of zero frames or less
+#define SERVO_TRACK_LENGTH    4     // waypoint durations do not add up to Frames
+#define SERVO_TRACK_EASING    5     // unknown easing curve
+
+struct ServoWaypoint
+{
+  int usec;      // target pulse width in microseconds
+  int frames;    // frames taken to reach it
+  int easing;    // SERVO_EASE_*
+};
+
+// ticks above 18 bits of timer width no longer fit 16 bits
+template <int Width>
+struct ServoTickType
+{
+  typedef typename std::conditional<(Width <= 18), uint16_t, uint32_t>::type type;
+};
+
+template <int Width, int Frames>
+struct ServoTickTrack
+{
+  typename ServoTickType<Width>::type ticks[Frames];
+  int error;
+};
+
+template <int N>
+constexpr int servoTrackLength(const ServoWaypoint (&points)[N])
+{
+  int frames = 0;
+  for (int i = 0; i < N; i++)
+    frames += points[i].frames;
+  return frames;
+}
+
+// eased fraction of a move in 16.16 fixed point, on the curves servoEase() uses at run time
+constexpr long servoEaseFraction(int frame, int frames, int easing)
+{
+  return servoEaseQuadratic(easing, (long)(((long long)frame << 16) / frames));
+}
+
+// rounded as ServoController rounds its eased moves (>> 16, so downwards)
+constexpr int servoEaseUs(int fromUs, int toUs, int frame, int frames, int easing)
+{
+  return fromUs + (int)(((long long)(toUs - fromUs) * servoEaseFraction(frame, frames, easing)) >> 16);
+}
+
+template <int Width, int Frames, int N>
+constexpr ServoTickTrack<Width, Frames> servoCompileTrack(int startUs, const ServoWaypoint (&points)[N],
+                                                          int minUs, int maxUs)
+{
+  static_assert((Width >= 16) && (Width <= 20), "timer width must be 16-20");
+  static_assert(Frames > 0, "a track needs at least one frame");
+  ServoTickTrack<Width, Frames> track = {};
+  track.error = SERVO_TRACK_OK;
+  if ((minUs < MIN_PULSE_WIDTH) || (maxUs > MAX_PULSE_WIDTH) || (minUs >= maxUs))
+    track.error = SERVO_TRACK_LIMITS;
+  else if ((startUs < minUs) || (startUs > maxUs))
+    track.error = SERVO_TRACK_RANGE;
+  else if (servoTrackLength(points) != Frames)
+    track.error = SERVO_TRACK_LENGTH;
+  if (track.error != SERVO_TRACK_OK)
+    return track;
+
+  int out = 0;
+  int fromUs = startUs;
+  for (int i = 0; i < N; i++)
+  {
+    const ServoWaypoint &p = points[i];
+    if ((p.usec < minUs) || (p.usec > maxUs))
+      track.error = SERVO_TRACK_RANGE;
+    else if (p.frames <= 0)
+      track.error = SERVO_TRACK_DURATION;
+    else if ((p.easing < SERVO_EASE_LINEAR) || (p.easing > SERVO_EASE_IN_OUT))
+      track.error = SERVO_TRACK_EASING;
+    if (track.error != SERVO_TRACK_OK)
+      return track;
+    for (int f = 1; f <= p.frames; f++)
+      track.ticks[out++] = servoUsToTicks(servoEaseUs(fromUs, p.usec, f, p.frames, p.easing), Width);
+    fromUs = p.usec;
+  }
+  return track;
+}
+
+template <int Width, int Frames>
+bool servoPlayTrackFrame(Servo &servo, const ServoTickTrack<Width, Frames> &track, int frame)
+{
+  if ((frame < 0) || (frame >= Frames) || (servo.readTimerWidth() != Width))
+    return false;
+  servo.writeTicks(track.ticks[frame]);
+  return true;
+}
+
+#endif
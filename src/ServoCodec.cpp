@@ -0,0 +1,161 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* This is a byte-oriented rANS decoder with a 32 bit state kept in
+* [SERVO_CODEC_RANS_L, 2**31). Each symbol costs a binary search over the
+* cumulative frequency table (30 entries), a multiply, and at most two byte
+* reads, so a 16 channel frame decodes in well under a microsecond of CPU
+* time per channel. Raw bits are coded as uniform symbols through the same
+* state, 12 bits at a time, which keeps the stream a single byte sequence.
+*/
+
+#include "ServoCodec.h"
+
+ServoMotionDecoder::ServoMotionDecoder()
+{
+    for (int i = 0; i <= SERVO_CODEC_SYMBOLS; i++)
+        this->cum[i] = 0;
+    for (int i = 0; i < MAX_SERVOS; i++)
+    {
+        this->last[i] = 0;
+        this->beforeLast[i] = 0;
+    }
+}
+
+bool ServoMotionDecoder::begin(const uint8_t *stream)
+{
+    const ServoCodecHeader *codec = (const ServoCodecHeader *)stream;
+    this->codec = 0;
+    if ((codec->motion.magic != SERVO_CODEC_MAGIC) || (codec->motion.version != SERVO_MOTION_VERSION))
+        return false;
+    if ((codec->motion.channels == 0) || (codec->motion.channels > MAX_SERVOS) || (codec->payloadBytes < 4))
+        return false;
+    uint32_t total = 0;
+    for (int s = 0; s < SERVO_CODEC_SYMBOLS; s++)
+    {
+        this->cum[s] = total;
+        total += codec->freq[s];
+    }
+    if (total != (1UL << SERVO_CODEC_SCALE_BITS))
+        return false;
+    this->cum[SERVO_CODEC_SYMBOLS] = total;
+
+    this->codec = codec;
+    this->ptr = stream + sizeof(ServoCodecHeader);
+    this->end = this->ptr + codec->payloadBytes;
+    this->state = this->ptr[0] | (this->ptr[1] << 8) | (this->ptr[2] << 16) | ((uint32_t)this->ptr[3] << 24);
+    this->ptr += 4;
+    for (int i = 0; i < MAX_SERVOS; i++)
+    {
+        this->last[i] = 0;
+        this->beforeLast[i] = 0;
+    }
+    this->frame = 0;
+    this->corrupt = false;
+    return true;
+}
+
+uint32_t ServoMotionDecoder::getBits(int bits)
+{
+    uint32_t value = this->state & ((1UL << bits) - 1);
+    this->state >>= bits;
+    while (this->state < SERVO_CODEC_RANS_L)
+    {
+        if (this->ptr >= this->end)
+        {
+            this->corrupt = true;
+            return 0;
+        }
+        this->state = (this->state << 8) | *this->ptr++;
+    }
+    return value;
+}
+
+bool ServoMotionDecoder::decodeFrame(uint32_t *ticks)
+{
+    if ((this->codec == 0) || this->corrupt || (this->frame >= (int)this->codec->motion.frameCount))
+        return false;
+
+    int channels = this->codec->motion.channels;
+    for (int c = 0; c < channels; c++)
+    {
+        // find the symbol whose frequency range holds the slot
+        uint32_t slot = this->state & ((1UL << SERVO_CODEC_SCALE_BITS) - 1);
+        int lo = 0;
+        int hi = SERVO_CODEC_SYMBOLS;
+        while (hi - lo > 1)
+        {
+            int mid = (lo + hi) >> 1;
+            if (this->cum[mid] <= slot)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        uint32_t freq = this->cum[lo+1] - this->cum[lo];
+        this->state = freq * (this->state >> SERVO_CODEC_SCALE_BITS) + slot - this->cum[lo];
+        while (this->state < SERVO_CODEC_RANS_L)
+        {
+            if (this->ptr >= this->end)
+            {
+                this->corrupt = true;
+                return false;
+            }
+            this->state = (this->state << 8) | *this->ptr++;
+        }
+
+        uint32_t z = lo;
+        if (lo >= 8)
+        {
+            int extra = lo - 5;     // bit length - 1
+            z = this->getBits(extra > 12 ? 12 : extra);
+            if (extra > 12)
+                z |= this->getBits(extra - 12) << 12;
+            z |= (1UL << extra);
+        }
+        if (this->corrupt)
+            return false;
+
+        uint32_t predicted = 2 * this->last[c] - this->beforeLast[c];
+        uint32_t value = predicted + (uint32_t)servoCodecUnzigzag(z);
+        this->beforeLast[c] = this->last[c];
+        this->last[c] = value;
+        ticks[c] = value;
+    }
+    this->frame++;
+    return true;
+}
+
+int ServoMotionDecoder::channels()
+{
+    return (this->codec ? this->codec->motion.channels : 0);
+}
+
+int ServoMotionDecoder::length()
+{
+    return (this->codec ? this->codec->motion.frameCount : 0);
+}
+
+int ServoMotionDecoder::readFrame()
+{
+    return (this->frame);
+}
+
+const ServoMotionHeader *ServoMotionDecoder::header()
+{
+    return (this->codec ? &this->codec->motion : 0);
+}
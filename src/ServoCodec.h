@@ -0,0 +1,123 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoCodec.h - Compression of baked servo motions
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Long shows do not fit in flash as raw tick frames (see ServoMotion.h).
+  Servo motion is smooth, so each tick value is predicted from the two
+  before it on the same channel (2 * previous - the one before that), and
+  only the prediction error is stored. Errors are mostly 0 or +-1; they are
+  entropy coded with rANS using a frequency table stored in the stream.
+
+  Small errors (zigzag value below 8) are coded as symbols of their own;
+  larger ones as a bit length symbol followed by the remaining bits.
+
+  The encoder runs offline (it uses only the C library); the decoder
+  produces one frame per call with no allocation, reading the stream in
+  place, so the compressed show can live in flash.
+
+  The class methods are:
+
+    ServoMotionDecoder() - Creates a decoder.
+    bool begin(stream) - Starts decoding a compressed motion; returns false
+        if the stream header is invalid.
+    bool decodeFrame(ticks) - Decodes the next frame (channels() values)
+        into ticks; returns false at the end of the motion or if the stream
+        is corrupt.
+    int channels() - Channels per frame.
+    int length() - Number of frames.
+    int readFrame() - Index of the next frame to decode.
+    const ServoMotionHeader *header() - The motion parameters (timer width,
+        refresh rate) of the stream.
+
+    int servoEncodeMotion(motion, out, maxBytes) - Compresses a baked
+        motion; returns the number of bytes written or -1 if out is too
+        small or motion is invalid.
+ */
+
+#ifndef ServoCodec_h
+#define ServoCodec_h
+
+#include <stdint.h>
+#include "ServoMotion.h"
+
+#define SERVO_CODEC_MAGIC         0x5A565253UL   // "SRVZ" in little endian
+#define SERVO_CODEC_SYMBOLS       30     // 8 literal errors + bit lengths 4-25
+#define SERVO_CODEC_SCALE_BITS    12     // symbol frequencies add up to 4096
+#define SERVO_CODEC_RANS_L        (1UL << 23)
+
+struct ServoCodecHeader
+{
+  ServoMotionHeader motion;              // magic is SERVO_CODEC_MAGIC
+  uint32_t payloadBytes;
+  uint16_t freq[SERVO_CODEC_SYMBOLS];
+};
+
+class ServoMotionDecoder
+{
+public:
+  ServoMotionDecoder();
+  bool begin(const uint8_t *stream);
+  bool decodeFrame(uint32_t *ticks);
+  int channels();
+  int length();
+  int readFrame();
+  const ServoMotionHeader *header();
+
+  private:
+   uint32_t getBits(int bits);           // raw (uniform) bits
+   const ServoCodecHeader *codec = 0;
+   const uint8_t *ptr = 0;               // next payload byte
+   const uint8_t *end = 0;
+   uint32_t state = 0;                   // rANS state
+   uint16_t cum[SERVO_CODEC_SYMBOLS+1];  // cumulative frequencies
+   uint32_t last[MAX_SERVOS];            // previous frame
+   uint32_t beforeLast[MAX_SERVOS];      // frame before that
+   int frame = 0;
+   bool corrupt = false;
+};
+
+int servoEncodeMotion(const uint32_t *motion, uint8_t *out, int maxBytes);
+
+// symbol mapping shared by the encoder and decoder
+inline uint32_t servoCodecZigzag(int32_t error)
+{
+  return ((uint32_t)error << 1) ^ (uint32_t)(error >> 31);
+}
+
+inline int32_t servoCodecUnzigzag(uint32_t z)
+{
+  return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+inline int servoCodecSymbol(uint32_t z, int *extraBits)
+{
+  if (z < 8)
+  {
+    *extraBits = 0;
+    return z;
+  }
+  int n = 0;
+  while ((z >> n) > 1)
+    n++;
+  *extraBits = n;             // bits below the leading one
+  return (n + 1) + 4;         // bit length 4 -> symbol 8
+}
+
+#endif
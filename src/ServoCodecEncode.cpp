@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* rANS is last in, first out, so the encoder walks the motion backwards
+* and writes bytes from the end of the output buffer towards the front;
+* the finished payload is then moved up behind the header. The first pass
+* only counts symbols to build the frequency table. Like the other offline
+* converters this uses only the C library, for use in host tools.
+*/
+
+#include <string.h>
+#include "ServoCodec.h"
+
+// prediction error of one value, as a zigzag code
+static uint32_t residual(const uint32_t *frames, int channels, int f, int c)
+{
+    uint32_t x = frames[f * channels + c];
+    uint32_t x1 = (f >= 1) ? frames[(f - 1) * channels + c] : 0;
+    uint32_t x2 = (f >= 2) ? frames[(f - 2) * channels + c] : 0;
+    return servoCodecZigzag((int32_t)(x - (2 * x1 - x2)));
+}
+
+static bool ransPut(uint32_t *x, uint8_t **p, uint8_t *floor, uint32_t start, uint32_t freq, int scaleBits)
+{
+    uint32_t xMax = ((SERVO_CODEC_RANS_L >> scaleBits) << 8) * freq;
+    while (*x >= xMax)
+    {
+        if (*p <= floor)
+            return false;
+        *--(*p) = (uint8_t)(*x & 0xFF);
+        *x >>= 8;
+    }
+    *x = ((*x / freq) << scaleBits) + (*x % freq) + start;
+    return true;
+}
+
+int servoEncodeMotion(const uint32_t *motion, uint8_t *out, int maxBytes)
+{
+    const ServoMotionHeader *header = (const ServoMotionHeader *)motion;
+    if ((header->magic != SERVO_MOTION_MAGIC) || (header->version != SERVO_MOTION_VERSION))
+        return -1;
+    int channels = header->channels;
+    int frameCount = header->frameCount;
+    if ((channels == 0) || (channels > MAX_SERVOS))
+        return -1;
+    if (maxBytes < (int)sizeof(ServoCodecHeader) + 4)
+        return -1;
+    const uint32_t *frames = motion + SERVO_MOTION_HEADER_WORDS;
+
+    // pass 1: symbol statistics
+    uint32_t counts[SERVO_CODEC_SYMBOLS];
+    int extra;
+    memset(counts, 0, sizeof(counts));
+    for (int f = 0; f < frameCount; f++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            int s = servoCodecSymbol(residual(frames, channels, f, c), &extra);
+            if (s >= SERVO_CODEC_SYMBOLS)
+                return -1;
+            counts[s]++;
+        }
+    }
+
+    // normalize to 2**SERVO_CODEC_SCALE_BITS, keeping every used symbol codable
+    uint16_t freq[SERVO_CODEC_SYMBOLS];
+    uint32_t total = (uint32_t)frameCount * channels;
+    int sum = 0;
+    int largest = 0;
+    for (int s = 0; s < SERVO_CODEC_SYMBOLS; s++)
+    {
+        freq[s] = 0;
+        if (counts[s] > 0)
+        {
+            uint32_t scaled = (uint32_t)(((uint64_t)counts[s] << SERVO_CODEC_SCALE_BITS) / total);
+            freq[s] = (scaled > 0) ? scaled : 1;
+        }
+        sum += freq[s];
+        if (freq[s] > freq[largest])
+            largest = s;
+    }
+    if (sum == 0)
+        freq[0] = sum = (1 << SERVO_CODEC_SCALE_BITS);   // empty motion
+    freq[largest] += (1 << SERVO_CODEC_SCALE_BITS) - sum;
+
+    uint16_t cum[SERVO_CODEC_SYMBOLS];
+    sum = 0;
+    for (int s = 0; s < SERVO_CODEC_SYMBOLS; s++)
+    {
+        cum[s] = sum;
+        sum += freq[s];
+    }
+
+    // pass 2: encode backwards; decoding reads symbol, low 12 raw bits, then the rest
+    uint8_t *floor = out + sizeof(ServoCodecHeader);
+    uint8_t *p = out + maxBytes;
+    uint32_t x = SERVO_CODEC_RANS_L;
+    for (int f = frameCount - 1; f >= 0; f--)
+    {
+        for (int c = channels - 1; c >= 0; c--)
+        {
+            uint32_t z = residual(frames, channels, f, c);
+            int s = servoCodecSymbol(z, &extra);
+            if (extra > 12)
+            {
+                if (!ransPut(&x, &p, floor, (z >> 12) & ((1UL << (extra - 12)) - 1), 1, extra - 12))
+                    return -1;
+                if (!ransPut(&x, &p, floor, z & 0xFFF, 1, 12))
+                    return -1;
+            }
+            else if (extra > 0)
+            {
+                if (!ransPut(&x, &p, floor, z & ((1UL << extra) - 1), 1, extra))
+                    return -1;
+            }
+            if (!ransPut(&x, &p, floor, cum[s], freq[s], SERVO_CODEC_SCALE_BITS))
+                return -1;
+        }
+    }
+    if (p - floor < 4)
+        return -1;
+    p -= 4;
+    p[0] = (uint8_t)(x);
+    p[1] = (uint8_t)(x >> 8);
+    p[2] = (uint8_t)(x >> 16);
+    p[3] = (uint8_t)(x >> 24);
+
+    int payloadBytes = (out + maxBytes) - p;
+    memmove(floor, p, payloadBytes);
+    ServoCodecHeader *codec = (ServoCodecHeader *)out;
+    codec->motion = *header;
+    codec->motion.magic = SERVO_CODEC_MAGIC;
+    codec->payloadBytes = payloadBytes;
+    for (int s = 0; s < SERVO_CODEC_SYMBOLS; s++)
+        codec->freq[s] = freq[s];
+    return (sizeof(ServoCodecHeader) + payloadBytes);
+}
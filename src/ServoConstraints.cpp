@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* Each constraint costs two or three tick to microsecond conversions (a
+* multiply and a shift) and a compare, so a full table of 32 is a few
+* hundred instructions per frame. When clamping, the new tick value is
+* rounded towards the safe side of the limit, so that reading it back in
+* microseconds cannot land past the limit.
+*/
+
+#include "ServoConstraints.h"
+
+ServoConstraints::ServoConstraints()
+{
+}
+
+int ServoConstraints::add(int a, int coefA, int b, int coefB, int32_t limit, int action)
+{
+    return (this->add(a, coefA, b, coefB, -1, 0, limit, action));
+}
+
+int ServoConstraints::add(int a, int coefA, int b, int coefB, int c, int coefC, int32_t limit, int action)
+{
+    if ((this->numConstraints >= SERVO_CONSTRAINT_MAX) || (coefA == 0) || (a < 0) || (b < 0))
+        return -1;
+    // a coefficient cut down to 16 bits would be a different constraint
+    if ((coefA > SERVO_CONSTRAINT_COEF_MAX) || (coefA < -SERVO_CONSTRAINT_COEF_MAX) ||
+        (coefB > SERVO_CONSTRAINT_COEF_MAX) || (coefB < -SERVO_CONSTRAINT_COEF_MAX) ||
+        ((c >= 0) && ((coefC > SERVO_CONSTRAINT_COEF_MAX) || (coefC < -SERVO_CONSTRAINT_COEF_MAX))))
+        return -1;
+    Constraint *k = &this->table[this->numConstraints];
+    k->terms = (c < 0) ? 2 : 3;
+    k->action = (action == SERVO_CONSTRAINT_REJECT) ? SERVO_CONSTRAINT_REJECT : SERVO_CONSTRAINT_CLAMP;
+    k->servo[0] = a;
+    k->servo[1] = b;
+    k->servo[2] = (c < 0) ? 0 : c;
+    k->coef[0] = coefA;
+    k->coef[1] = coefB;
+    k->coef[2] = (c < 0) ? 0 : coefC;
+    k->limit = limit;
+    return (this->numConstraints++);
+}
+
+int ServoConstraints::count()
+{
+    return (this->numConstraints);
+}
+
+uint32_t ServoConstraints::violations()
+{
+    return (this->violationCount);
+}
+
+int ServoConstraints::apply(ServoGroup &group)
+{
+    int violated = 0;
+    for (int n = 0; n < this->numConstraints; n++)
+    {
+        Constraint *k = &this->table[n];
+        Servo *servos[3];
+        int us[3];
+        int64_t sum = 0;
+        bool valid = true;
+        for (int t = 0; t < k->terms; t++)
+        {
+            servos[t] = group.servo(k->servo[t]);
+            if (servos[t] == 0)
+            {
+                valid = false;
+                break;
+            }
+            us[t] = servoTicksToUs(group.readStagedTicks(k->servo[t]), servos[t]->readTimerWidth());
+            sum += (int64_t)k->coef[t] * us[t];
+        }
+        if (!valid || (sum <= k->limit))
+            continue;
+        violated++;
+
+        bool reject = (k->action == SERVO_CONSTRAINT_REJECT);
+        if (!reject)
+        {
+            // move the first servo back just far enough
+            int coef = k->coef[0];
+            int64_t excess = sum - k->limit;
+            int magnitude = (coef > 0) ? coef : -coef;
+            int delta = (int)((excess + magnitude - 1) / magnitude);
+            int target = (coef > 0) ? (us[0] - delta) : (us[0] + delta);
+            if ((target < servos[0]->readMin()) || (target > servos[0]->readMax()))
+            {
+                reject = true;
+            }
+            else
+            {
+                int width = servos[0]->readTimerWidth();
+                int ticks = servoUsToTicks(target, width);
+                if ((coef < 0) && (servoTicksToUs(ticks, width) < target))
+                    ticks++;
+                group.restage(k->servo[0], ticks);   // within min and max, as checked above
+            }
+        }
+        if (reject)
+        {
+            for (int t = 0; t < k->terms; t++)
+                group.revert(k->servo[t]);
+        }
+    }
+    this->violationCount += violated;
+    return violated;
+}
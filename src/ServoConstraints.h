@@ -0,0 +1,93 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoConstraints.h - Joint interference limits checked before each commit
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Some joint combinations collide (an elbow folded in while the shoulder is
+  low, say). A ServoConstraints table holds up to SERVO_CONSTRAINT_MAX
+  linear limits over two or three servos of a ServoGroup, each of the form
+
+      coefA * A + coefB * B (+ coefC * C) <= limit
+
+  with A, B, C the pulse widths in microseconds of the servos at those group
+  indices, as staged (before backlash compensation, which commit() applies
+  to what passes). Once attached with ServoGroup::setConstraints(), the table is
+  checked against the staged values at the start of every commit(), in one
+  pass in the order the constraints were added. A violated constraint is
+  either clamped (the first servo of the constraint is moved back just far
+  enough to satisfy it) or rejected (every servo of the constraint keeps
+  its last committed value; with a frame ring, its value in the last
+  frame queued). A rejected servo is not written in that commit(), so it
+  does not feed its watchdog (see Servo::setWatchdog()). If clamping would
+  put the first servo outside its min/max, the constraint is rejected
+  instead.
+
+  The class methods are:
+
+    ServoConstraints() - Creates an empty table.
+    int add(a, coefA, b, coefB, limit, action) - Adds a two servo limit;
+        action is SERVO_CONSTRAINT_CLAMP (default) or SERVO_CONSTRAINT_REJECT.
+        Returns the constraint number, or -1 if the table is full, coefA
+        is 0 (the clamped servo must appear in the constraint) or a
+        coefficient is outside +-SERVO_CONSTRAINT_COEF_MAX.
+    int add(a, coefA, b, coefB, c, coefC, limit, action) - Adds a three
+        servo limit.
+    int count() - Number of constraints.
+    int apply(group) - Checks and fixes the staged values of group; returns
+        the number of violated constraints. commit() calls this.
+    uint32_t violations() - Violations seen since the table was created.
+ */
+
+#ifndef ServoConstraints_h
+#define ServoConstraints_h
+
+#include <stdint.h>
+#include "ServoGroup.h"
+
+#define SERVO_CONSTRAINT_MAX       32
+#define SERVO_CONSTRAINT_CLAMP      0     // move the first servo back onto the limit
+#define SERVO_CONSTRAINT_REJECT     1     // keep the last committed values
+#define SERVO_CONSTRAINT_COEF_MAX  32767    // largest coefficient magnitude (they are stored in 16 bits)
+
+class ServoConstraints
+{
+public:
+  ServoConstraints();
+  int add(int a, int coefA, int b, int coefB, int32_t limit, int action = SERVO_CONSTRAINT_CLAMP);
+  int add(int a, int coefA, int b, int coefB, int c, int coefC, int32_t limit,
+          int action = SERVO_CONSTRAINT_CLAMP);
+  int count();
+  int apply(ServoGroup &group);
+  uint32_t violations();
+
+  private:
+   struct Constraint
+   {
+     uint8_t terms;           // 2 or 3
+     uint8_t action;
+     uint8_t servo[3];        // group indices
+     int16_t coef[3];
+     int32_t limit;
+   };
+   Constraint table[SERVO_CONSTRAINT_MAX];
+   int numConstraints = 0;
+   uint32_t violationCount = 0;
+};
+
+#endif
@@ -0,0 +1,496 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* Only servos that are moving are staged, so a frame in which nothing
+* moves costs a loop over the axes and an empty commit. Events are
+* dispatched to the callbacks first and then queued, so a callback sees an
+* event no later than the application does. Only update() raises events:
+* a target clamped by moveTo() or queueMove() is noted on its axis and
+* reported by the next update(), so the event queue has a single producer.
+* Nothing else is shared safely between tasks: the segment pool is one
+* static free list for every controller, and the axes' queues are changed
+* by both queueMove() and update() with no lock, so every call must come
+* from the task that runs update(); only the event queue may be popped
+* elsewhere. The supply
+* scale is read once per update(), so every axis moves at the same
+* fraction of its speed in a frame and a multi-servo move keeps its shape
+* while it slows down.
+*
+* Linear segments keep their position in 24.8 fixed point, so a timed
+* segment covers its distance in exactly its frames even when that is not
+* a whole number of microseconds per frame. The pool needs no setup: it
+* hands out never used segments from the top until it has run through them,
+* then recycles freed ones from a free list linked through next.
+* Blending is the usual trapezoid: each frame the step may grow by the
+* acceleration, and is kept low enough that steps shrinking by the
+* acceleration reach v, the speed allowed on arrival, within the remaining
+* distance d (about sqrt(v*v + 2*a*d)). v comes from a backward pass over
+* the queued segments that carry on in the same direction (ending at rest
+* after the last of them), which plan() runs only when the queue or the
+* current segment changes; a frame takes a square root only while braking.
+*/
+
+#include "ServoController.h"
+
+ServoController::Segment ServoController::Pool[SERVO_SEGMENT_POOL];
+uint8_t ServoController::PoolTop = 0;
+uint8_t ServoController::FreeList = SERVO_SEGMENT_NONE;
+int ServoController::SegmentsUsed = 0;
+
+static_assert(SERVO_SEGMENT_POOL <= SERVO_SEGMENT_NONE, "segments are numbered by uint8_t");
+
+// speed of a linear segment over distance microseconds, 24.8; 0 = at once
+static int32_t cruiseOf(int rate, bool timed, int distance)
+{
+    if (rate <= 0)
+        return 0;
+    if (timed)
+        return ((((int32_t)distance) << 8) + rate - 1) / rate;
+    return ((int32_t)rate << 8);
+}
+
+ServoController::ServoController(ServoGroup &group)
+{
+    this->group = &group;
+    for (int i = 0; i < MAX_SERVOS; i++)
+    {
+        Servo *servo = group.servo(i);
+        int position = servo ? servo->readMicroseconds() : 0;
+        this->axes[i].position = position;
+        this->axes[i].target = position;
+        this->axes[i].start = position;
+        this->axes[i].easing = SERVO_EASE_LINEAR;
+        this->axes[i].progress = 0;
+        this->axes[i].duration = 0;
+        this->axes[i].fine = (int32_t)position << 8;
+        this->axes[i].cruise = 0;
+        this->axes[i].velocity = 0;
+        this->axes[i].exitVelocity = 0;
+        this->axes[i].direction = 0;
+        this->axes[i].curved = false;
+        this->axes[i].moving = false;
+        this->axes[i].stalled = false;
+        this->axes[i].stallFrames = 0;
+        this->axes[i].limited = false;
+        this->axes[i].limitValue = 0;
+        this->axes[i].head = SERVO_SEGMENT_NONE;
+        this->axes[i].tail = SERVO_SEGMENT_NONE;
+        this->axes[i].queued = 0;
+    }
+}
+
+ServoController::~ServoController()
+{
+    for (int i = 0; i < MAX_SERVOS; i++)
+        this->clearQueue(&this->axes[i]);
+}
+
+int ServoController::clampTarget(Servo *servo, int index, int value)
+{
+    int min = servo->readMin();
+    int max = servo->readMax();
+    value = servoAngleToUs(value, min, max);
+    if ((value < min) || (value > max))
+    {
+        // reported by the next update(), the only producer on the event queue
+        value = (value < min) ? min : max;
+        this->axes[index].limited = true;
+        this->axes[index].limitValue = value;
+    }
+    return value;
+}
+
+void ServoController::moveTo(int index, int value, int speed, int easing)
+{
+    this->enqueue(index, value, speed, false, easing, SERVO_QUEUE_REPLACE);
+}
+
+bool ServoController::queueMove(int index, int value, int speed, int easing, int mode)
+{
+    return (this->enqueue(index, value, speed, false, easing, mode));
+}
+
+bool ServoController::queueTimed(int index, int value, int frames, int easing, int mode)
+{
+    return (this->enqueue(index, value, frames, true, easing, mode));
+}
+
+bool ServoController::enqueue(int index, int value, int rate, bool timed, int easing, int mode)
+{
+    Servo *servo = this->group->servo(index);
+    if (servo == 0)
+        return false;
+    value = this->clampTarget(servo, index, value);
+    if (rate < 0)
+        rate = 0;
+    else if (rate > 0xFFFF)
+        rate = 0xFFFF;
+    Axis *axis = &this->axes[index];
+    if (mode != SERVO_QUEUE_APPEND)
+        this->clearQueue(axis);
+    if ((mode == SERVO_QUEUE_REPLACE) || !axis->moving)
+    {
+        this->begin(axis, value, rate, timed, easing);
+        return true;
+    }
+
+    uint8_t slot;
+    if (FreeList != SERVO_SEGMENT_NONE)
+    {
+        slot = FreeList;
+        FreeList = Pool[slot].next;
+    }
+    else if (PoolTop < SERVO_SEGMENT_POOL)
+        slot = PoolTop++;
+    else
+        return false;
+    SegmentsUsed++;
+    Segment *segment = &Pool[slot];
+    segment->target = value;
+    segment->rate = rate;
+    segment->easing = easing;
+    segment->timed = timed;
+    segment->next = SERVO_SEGMENT_NONE;
+    if (axis->tail == SERVO_SEGMENT_NONE)
+        axis->head = slot;
+    else
+        Pool[axis->tail].next = slot;
+    axis->tail = slot;
+    axis->queued++;
+    this->plan(axis);
+    return true;
+}
+
+// starts a segment from where the axis is
+void ServoController::begin(Axis *axis, int target, int rate, bool timed, int easing)
+{
+    int distance = target - axis->position;
+    int8_t direction = (distance > 0) ? 1 : ((distance < 0) ? -1 : 0);
+    if (distance < 0)
+        distance = -distance;
+    // an eased move lasts as long as a linear move at this speed would
+    int frames = timed ? rate : ((rate > 0) ? (distance + rate - 1) / rate : 0);
+    if ((direction != axis->direction) || (direction == 0))
+        axis->velocity = 0;                 // a reversal starts from rest
+    axis->target = target;
+    axis->start = axis->position;
+    axis->easing = easing;
+    axis->direction = direction;
+    axis->cruise = cruiseOf(rate, timed, distance);
+    axis->curved = (frames > 0) && ((easing != SERVO_EASE_LINEAR) || (distance == 0));
+    axis->progress = 0;
+    axis->duration = ((frames > 0) ? frames : 1) << 8;
+    axis->fine = (int32_t)axis->position << 8;
+    if (axis->curved)
+        axis->velocity = 0;
+    axis->moving = true;
+    this->plan(axis);
+}
+
+// the speed allowed at the end of the current segment, when blending
+void ServoController::plan(Axis *axis)
+{
+    axis->exitVelocity = 0;
+    if ((this->blend <= 0) || axis->curved || (axis->direction == 0))
+        return;
+    // the queued linear segments that carry on in the same direction
+    int32_t cruise[SERVO_LOOKAHEAD];
+    int32_t length[SERVO_LOOKAHEAD];
+    int n = 0;
+    int from = axis->target;
+    for (uint8_t i = axis->head; (i != SERVO_SEGMENT_NONE) && (n < SERVO_LOOKAHEAD); i = Pool[i].next)
+    {
+        const Segment *segment = &Pool[i];
+        int distance = (segment->target - from) * axis->direction;
+        if ((distance <= 0) || (segment->rate == 0) || (segment->easing != SERVO_EASE_LINEAR))
+            break;
+        cruise[n] = cruiseOf(segment->rate, segment->timed, distance);
+        length[n] = (int32_t)distance << 8;
+        from = segment->target;
+        n++;
+    }
+    // backwards, from rest after the last of them
+    int64_t accel = (int64_t)this->blend << 8;
+    int64_t v = 0;
+    while (n-- > 0)
+    {
+        int64_t reach = servoSqrt(v * v + 2 * accel * length[n] + accel * accel / 4) - accel / 2;
+        v = (reach < cruise[n]) ? reach : cruise[n];
+    }
+    axis->exitVelocity = (int32_t)v;
+}
+
+// moves on to the first queued segment; carry is what the segment that
+// just ended left of this frame (24.8 microseconds if it was linear,
+// frames if it was curved)
+void ServoController::next(Axis *axis, int32_t carry)
+{
+    uint8_t slot = axis->head;
+    Segment segment = Pool[slot];
+    axis->head = segment.next;
+    if (axis->head == SERVO_SEGMENT_NONE)
+        axis->tail = SERVO_SEGMENT_NONE;
+    axis->queued--;
+    Pool[slot].next = FreeList;
+    FreeList = slot;
+    SegmentsUsed--;
+
+    int8_t direction = axis->direction;
+    bool curved = axis->curved;
+    this->begin(axis, segment.target, segment.rate, segment.timed, segment.easing);
+    if (carry <= 0)
+        return;
+    if (curved && axis->curved)
+        axis->progress = carry;
+    else if (!curved && !axis->curved && (axis->cruise > 0) && (axis->direction == direction))
+    {
+        int32_t remaining = ((int32_t)axis->target << 8) - axis->fine;
+        if (remaining < 0)
+            remaining = -remaining;
+        if (carry > remaining)
+            carry = remaining;
+        axis->fine += direction * carry;
+        axis->position = (axis->fine + 128) >> 8;
+    }
+}
+
+void ServoController::clearQueue(Axis *axis)
+{
+    while (axis->head != SERVO_SEGMENT_NONE)
+    {
+        uint8_t slot = axis->head;
+        axis->head = Pool[slot].next;
+        Pool[slot].next = FreeList;
+        FreeList = slot;
+        SegmentsUsed--;
+    }
+    axis->tail = SERVO_SEGMENT_NONE;
+    axis->queued = 0;
+    axis->exitVelocity = 0;
+}
+
+int ServoController::queued(int index)
+{
+    if ((index < 0) || (index >= this->group->count()))
+        return 0;
+    return (this->axes[index].queued);
+}
+
+void ServoController::setBlend(int accel)
+{
+    this->blend = (accel > 0) ? accel : 0;
+    for (int i = 0; i < MAX_SERVOS; i++)
+        this->plan(&this->axes[i]);
+}
+
+int ServoController::freeSegments()
+{
+    return (SERVO_SEGMENT_POOL - SegmentsUsed);
+}
+
+void ServoController::stop(int index)
+{
+    if ((index >= 0) && (index < this->group->count()))
+    {
+        Axis *axis = &this->axes[index];
+        this->clearQueue(axis);
+        axis->moving = false;
+        axis->target = axis->position;
+        axis->velocity = 0;
+    }
+}
+
+bool ServoController::moving(int index)
+{
+    if ((index < 0) || (index >= this->group->count()))
+        return false;
+    return (this->axes[index].moving);
+}
+
+int ServoController::readPosition(int index)
+{
+    if ((index < 0) || (index >= this->group->count()))
+        return 0;
+    return (this->axes[index].position);
+}
+
+int ServoController::readTarget(int index)
+{
+    if ((index < 0) || (index >= this->group->count()))
+        return 0;
+    return (this->axes[index].target);
+}
+
+void ServoController::setFeedback(ServoFeedback feedback, void *context, int tolerance)
+{
+    this->feedback = feedback;
+    this->feedbackContext = context;
+    this->tolerance = tolerance;
+}
+
+int ServoController::onEvent(uint16_t typeMask, ServoEventCallback callback, void *context)
+{
+    return (this->slots.add(typeMask, callback, context));
+}
+
+void ServoController::removeEvent(int slot)
+{
+    this->slots.remove(slot);
+}
+
+void ServoController::setEventQueue(ServoEventQueue *queue)
+{
+    this->queue = queue;
+}
+
+void ServoController::setSupply(ServoSupply *supply)
+{
+    this->supply = supply;
+}
+
+void ServoController::raise(uint8_t type, int index, int value)
+{
+    ServoEvent event;
+    event.type = type;
+    event.servo = index;
+    event.value = value;
+    event.frame = this->frame;
+    this->slots.dispatch(event);
+    if (this->queue)
+        this->queue->push(event);
+}
+
+void ServoController::update()
+{
+    int count = this->group->count();
+    int scale = this->supply ? this->supply->readScale() : SERVO_SUPPLY_SCALE_ONE;
+    for (int i = 0; i < count; i++)
+    {
+        Axis *axis = &this->axes[i];
+        if (axis->limited)
+        {
+            axis->limited = false;
+            this->raise(SERVO_EVENT_LIMIT_REACHED, i, axis->limitValue);
+        }
+        if (axis->moving && (scale > 0))   // a critical supply holds every move where it is
+        {
+            bool arrived;
+            int32_t carry = 0;
+            if (axis->curved)
+            {
+                // eased: advance along the curve; a low supply slows the clock of the move
+                axis->progress += scale;
+                arrived = (axis->progress >= axis->duration);
+                if (arrived)
+                {
+                    carry = axis->progress - axis->duration;
+                    axis->position = axis->target;
+                }
+                else
+                    axis->position = axis->start + (int)(((long long)(axis->target - axis->start) *
+                        servoEase(axis->easing, ((int64_t)axis->progress << 16) / axis->duration)) >> 16);
+                // back and elastic curves overshoot; never past the servo's limits
+                Servo *servo = this->group->servo(i);
+                if (axis->position < servo->readMin())
+                    axis->position = servo->readMin();
+                else if (axis->position > servo->readMax())
+                    axis->position = servo->readMax();
+                axis->fine = (int32_t)axis->position << 8;
+            }
+            else
+            {
+                int32_t cruise = axis->cruise;
+                if (scale < SERVO_SUPPLY_SCALE_ONE)
+                {
+                    if (cruise == 0)
+                        cruise = (int32_t)this->supply->readFullSpeed() << 8;
+                    cruise = (cruise * scale) >> 8;
+                    if (cruise < 256)
+                        cruise = 256;
+                }
+                int32_t goal = (int32_t)axis->target << 8;
+                int32_t remaining = goal - axis->fine;
+                if (remaining < 0)
+                    remaining = -remaining;
+                int32_t step = (cruise > 0) ? cruise : remaining;
+                if ((cruise > 0) && (this->blend > 0))
+                {
+                    int64_t accel = (int64_t)this->blend << 8;
+                    if (step > axis->velocity + accel)
+                        step = axis->velocity + accel;
+                    // braking: steps of v, v - a, v - 2a ... down to the arrival speed
+                    // cover the remaining distance when (v + a/2)**2 <= exit**2 + 2ad + a*a/4
+                    int64_t budget = (int64_t)axis->exitVelocity * axis->exitVelocity + 2 * accel * remaining +
+                                     accel * accel / 4;
+                    int64_t half = accel / 2;
+                    if ((step + half) * (step + half) > budget)
+                        step = (int32_t)(servoSqrt(budget) - half);
+                }
+                arrived = (step >= remaining);
+                if (arrived)
+                {
+                    carry = step - remaining;
+                    axis->fine = goal;
+                }
+                else
+                    axis->fine += axis->direction * step;
+                axis->velocity = step;
+                axis->position = (axis->fine + 128) >> 8;
+            }
+            if (arrived && (axis->head != SERVO_SEGMENT_NONE))
+            {
+                this->next(axis, carry);
+                arrived = false;
+            }
+            this->group->stageMicroseconds(i, axis->position);
+            if (arrived)
+            {
+                axis->moving = false;
+                axis->velocity = 0;
+                this->raise(SERVO_EVENT_MOTION_COMPLETE, i, axis->position);
+            }
+        }
+        if (this->feedback)
+        {
+            int measured = this->feedback(i, this->feedbackContext);
+            int error = measured - axis->position;
+            if ((error > this->tolerance) || (error < -this->tolerance))
+            {
+                if (axis->stallFrames < SERVO_STALL_FRAMES)
+                    axis->stallFrames++;
+                if ((axis->stallFrames == SERVO_STALL_FRAMES) && !axis->stalled)
+                {
+                    axis->stalled = true;
+                    this->raise(SERVO_EVENT_STALL, i, measured);
+                }
+            }
+            else
+            {
+                axis->stallFrames = 0;
+                axis->stalled = false;
+            }
+        }
+    }
+    this->group->commit();
+    this->frame++;
+}
+
+uint32_t ServoController::readFrame()
+{
+    return (this->frame);
+}
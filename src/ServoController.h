@@ -0,0 +1,210 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoController.h - Frame-based moves and events for a ServoGroup
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Servo::write() moves a servo at full speed, and there is no way to learn
+  when it got there. A ServoController moves the servos of a ServoGroup
+  towards targets at a set speed, one step per frame, and raises events
+  (see ServoEvents.h) from its update():
+
+    SERVO_EVENT_MOTION_COMPLETE - a move reached its target (value = target)
+    SERVO_EVENT_LIMIT_REACHED   - a target was clamped to the servo's min or
+                                  max (value = the clamped target; raised
+                                  by the next update(), once for the last
+                                  clamped target)
+    SERVO_EVENT_STALL           - position feedback (if set) stayed more than
+                                  the tolerance away from the commanded
+                                  position for SERVO_STALL_FRAMES frames
+                                  (value = the measured position)
+
+  Servos are referred to by their index in the group. A controller (and
+  the segment pool all controllers share) is not safe to use from two
+  tasks: call every method from the task that runs update(), and hand
+  events to other tasks through setEventQueue().
+
+  Each servo also has a queue of segments (a target, a speed or a duration,
+  and a curve), which run back to back: a segment starts at the junction,
+  in the same update() in which the one before it arrives. A linear
+  segment that continues in the same direction (or a curved one after a
+  curved one) takes the rest of that frame's step, so a path through
+  waypoints never stops at them; any other makes its first step in the
+  next frame. With setBlend(), speed changes
+  between linear segments are ramped at a set acceleration, looking ahead
+  up to SERVO_LOOKAHEAD segments to slow down in time for reversals, curved
+  segments and the end of the queue. Queued segments come from a pool of
+  SERVO_SEGMENT_POOL shared by all controllers; nothing is allocated. A new
+  segment either replaces the queue (SERVO_QUEUE_REPLACE, starting at once
+  from where the servo is), is appended to it (SERVO_QUEUE_APPEND), or
+  replaces what is queued after the current segment (SERVO_QUEUE_MERGE).
+  SERVO_EVENT_MOTION_COMPLETE is raised when the queue runs out.
+
+  The class methods are:
+
+    ServoController(group) - Creates a controller for group; call after the
+        servos have been added to the group and attached.
+    ~ServoController() - Returns the queued segments to the pool.
+    void moveTo(index, value, speed, easing) - Starts a move. value is
+        treated as in Servo::write() (below 500 is degrees); speed is in
+        microseconds per frame (0 moves at once, on the next update()).
+        easing is a SERVO_EASE_* curve (see ServoEasing.h); an eased move
+        takes as many frames as a linear one at speed would. Clears the
+        queue.
+    bool queueMove(index, value, speed, easing, mode) - Adds a segment to
+        the queue as mode (SERVO_QUEUE_*) says; value, speed and easing are
+        as in moveTo(). Returns false if the pool is used up.
+    bool queueTimed(index, value, frames, easing, mode) - Adds a segment
+        that takes frames frames (the same target twice is a pause).
+    int queued(index) - Number of segments waiting behind the current one.
+    void setBlend(accel) - Ramps speed changes at junctions of linear
+        segments at accel microseconds per frame per frame (0, the default,
+        changes speed at once).
+    void stop(index) - Stops a move where it is and clears the queue (no
+        completion event).
+    bool moving(index) - True while a move is in progress.
+    int readPosition(index) - Commanded position in microseconds.
+    int readTarget(index) - Target of the current (or last) move.
+    void setFeedback(function, context, tolerance) - Enables stall detection
+        with a function returning the measured position of a servo in
+        microseconds (e.g. from a potentiometer on an ADC pin).
+    int onEvent(typeMask, callback, context) - Registers a callback for the
+        event types in typeMask; returns its slot, or -1 if none is free.
+    void removeEvent(slot) - Unregisters a callback.
+    void setEventQueue(queue) - Also pushes every event into queue, for the
+        application to pop later (0 to stop).
+    void setSupply(supply) - Scales the speed of every move by the supply
+        voltage, and holds the moves while it is critical (see ServoSupply.h;
+        0 to stop).
+    void update() - Advances every move by one frame, commits the group,
+        and raises events. Call this once per frame.
+    uint32_t readFrame() - Number of update() calls so far.
+    static int freeSegments() - Number of unused segments in the pool.
+
+  The functions are:
+
+    int64_t servoSqrt(x) - floor(sqrt(x)) for x >= 0, in integer arithmetic
+        (for stopping distances; see also ServoPlanner.h). Declared in
+        ServoMath.h.
+ */
+
+#ifndef ServoController_h
+#define ServoController_h
+
+#include <stdint.h>
+#include "ServoGroup.h"
+#include "ServoEvents.h"
+#include "ServoSupply.h"
+#include "ServoEasing.h"
+#include "ServoMath.h"
+
+#define SERVO_STALL_FRAMES   10     // frames of disagreement before a stall is reported
+
+#ifndef SERVO_SEGMENT_POOL
+#define SERVO_SEGMENT_POOL   64     // queued segments, shared by all controllers; at most 255
+#endif
+#define SERVO_LOOKAHEAD       8     // queued segments looked at when blending
+#define SERVO_SEGMENT_NONE  255     // end of a list of segments
+
+#define SERVO_QUEUE_REPLACE   0     // drop the queue and start now
+#define SERVO_QUEUE_APPEND    1     // run after everything queued
+#define SERVO_QUEUE_MERGE     2     // run after the current segment, dropping the rest
+
+typedef int (*ServoFeedback)(int index, void *context);   // measured pulse width in microseconds
+
+class ServoController
+{
+public:
+  ServoController(ServoGroup &group);
+  ~ServoController();
+  void moveTo(int index, int value, int speed = 0, int easing = SERVO_EASE_LINEAR);
+  bool queueMove(int index, int value, int speed, int easing = SERVO_EASE_LINEAR,
+                 int mode = SERVO_QUEUE_APPEND);
+  bool queueTimed(int index, int value, int frames, int easing = SERVO_EASE_LINEAR,
+                  int mode = SERVO_QUEUE_APPEND);
+  int queued(int index);
+  void setBlend(int accel);
+  void stop(int index);
+  bool moving(int index);
+  int readPosition(int index);
+  int readTarget(int index);
+  void setFeedback(ServoFeedback feedback, void *context, int tolerance);
+  int onEvent(uint16_t typeMask, ServoEventCallback callback, void *context);
+  void removeEvent(int slot);
+  void setEventQueue(ServoEventQueue *queue);
+  void setSupply(ServoSupply *supply);
+  void update();
+  uint32_t readFrame();
+  static int freeSegments();
+
+  private:
+   struct Segment
+   {
+     int16_t target;            // microseconds, already clamped
+     uint16_t rate;             // speed, or frames if timed
+     uint8_t easing;
+     bool timed;
+     uint8_t next;              // index in Pool, or SERVO_SEGMENT_NONE
+   };
+   struct Axis
+   {
+     int position;              // commanded pulse width, microseconds
+     int target;
+     int start;                 // position when the segment began
+     int easing;                // SERVO_EASE_*
+     int32_t progress;          // curved segments: frames elapsed, 24.8 fixed point
+     int32_t duration;          // curved segments: frames in the segment, 24.8
+     int32_t fine;              // linear segments: position, 24.8
+     int32_t cruise;            // linear segments: microseconds per frame, 24.8; 0 = at once
+     int32_t velocity;          // linear segments: step of the last frame, 24.8
+     int32_t exitVelocity;      // blending: fastest step allowed on arrival, 24.8
+     int8_t direction;          // of the segment: 1, -1, or 0 if it does not move
+     bool curved;               // follows its curve over duration, rather than at cruise
+     bool moving;
+     bool stalled;              // a stall has been reported and not yet cleared
+     uint8_t stallFrames;
+     bool limited;              // a target was clamped since the last update()
+     int limitValue;            // the clamped target, for SERVO_EVENT_LIMIT_REACHED
+     uint8_t head;              // queued segments, first and last (SERVO_SEGMENT_NONE if none)
+     uint8_t tail;
+     uint8_t queued;
+   };
+   int clampTarget(Servo *servo, int index, int value);
+   bool enqueue(int index, int value, int rate, bool timed, int easing, int mode);
+   void begin(Axis *axis, int target, int rate, bool timed, int easing);
+   void plan(Axis *axis);
+   void next(Axis *axis, int32_t carry);
+   void clearQueue(Axis *axis);
+   void raise(uint8_t type, int index, int value);
+   ServoGroup *group;
+   Axis axes[MAX_SERVOS];
+   ServoEventSlots slots;
+   ServoEventQueue *queue = 0;
+   ServoSupply *supply = 0;
+   ServoFeedback feedback = 0;
+   void *feedbackContext = 0;
+   int tolerance = 0;
+   uint32_t frame = 0;
+   int blend = 0;
+   static Segment Pool[SERVO_SEGMENT_POOL];
+   static uint8_t PoolTop;                 // segments above this have never been used
+   static uint8_t FreeList;                // freed segments, linked by next
+   static int SegmentsUsed;
+};
+
+#endif
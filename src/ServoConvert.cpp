@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The vector code has to give the scalar results exactly, so it avoids the
+* two operations vector units do not have in integer form:
+*
+* - Degrees to microseconds is deg * (max - min) / 180, truncated. The
+*   product is below 2**24, so it is exact as a float, and a correctly
+*   rounded float quotient never crosses the integer the true quotient is
+*   below (quotients are at least 1/180 away from the next integer, far more
+*   than half a float ulp at these magnitudes), so float division followed
+*   by truncation is exact.
+* - servoUsToTicks() divides N = (us << width) + REFRESH_USEC / 2 by
+*   REFRESH_USEC. N is below 2**32 for us <= 4095, and for every such N,
+*   N / 20000 == (N * 0xD1B71759) >> 46 (the usual multiply by a rounded up
+*   reciprocal), which takes a 32 x 32 -> 64 bit multiply per element
+*   (_mm_mul_epu32, two elements at a time).
+*
+* Clamping is done with compares and selects rather than min/max, so that
+* even a min above max gives what writeMicroseconds() gives (below min is
+* min, otherwise above max is max).
+* The tail that does not fill a vector goes through the scalar code.
+*/
+
+#include "ServoConvert.h"
+#include "ServoMath.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SERVO_CONVERT_USE SERVO_CONVERT_SSE2
+#else
+#define SERVO_CONVERT_USE SERVO_CONVERT_SCALAR
+#endif
+
+#define SERVO_CONVERT_MAGIC   0xD1B71759UL   // ceil(2**46 / REFRESH_USEC)
+#define SERVO_CONVERT_SHIFT   46
+
+static_assert(REFRESH_USEC == 20000, "SERVO_CONVERT_MAGIC is computed for REFRESH_USEC");
+
+static inline uint32_t convertOne(int value, int min, int max, int timerWidth, bool angles)
+{
+    // as Servo::write() and Servo::writeMicroseconds()
+    if (angles)
+        value = servoAngleToUs(value, min, max);
+    if (value < min)
+        value = min;
+    else if (value > max)
+        value = max;
+    return servoUsToTicks(value, timerWidth);
+}
+
+#if SERVO_CONVERT_USE == SERVO_CONVERT_SSE2
+
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static int convertVector(const int16_t *values, const int *minUs, const int *maxUs,
+                         uint32_t *ticks, int count, int timerWidth, bool angles)
+{
+    const __m128i half = _mm_set1_epi32(REFRESH_USEC / 2);
+    const __m128i magic = _mm_set1_epi32((int)SERVO_CONVERT_MAGIC);
+    const __m128i width = _mm_cvtsi32_si128(timerWidth);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadl_epi64((const __m128i *)(values + i));
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);         // sign extend
+        __m128i min = _mm_loadu_si128((const __m128i *)(minUs + i));
+        __m128i max = _mm_loadu_si128((const __m128i *)(maxUs + i));
+        if (angles)
+        {
+            __m128i isAngle = _mm_cmplt_epi32(v, _mm_set1_epi32(MIN_PULSE_WIDTH));
+            __m128i deg = _mm_andnot_si128(_mm_cmplt_epi32(v, _mm_setzero_si128()), v);
+            deg = select(_mm_cmpgt_epi32(deg, _mm_set1_epi32(180)), _mm_set1_epi32(180), deg);
+            __m128 product = _mm_mul_ps(_mm_cvtepi32_ps(deg), _mm_cvtepi32_ps(_mm_sub_epi32(max, min)));
+            __m128i us = _mm_add_epi32(_mm_cvttps_epi32(_mm_div_ps(product, _mm_set1_ps(180.0f))), min);
+            v = select(isAngle, us, v);
+        }
+        __m128i below = _mm_cmplt_epi32(v, min);     // both tested on the unclamped value
+        v = select(_mm_cmpgt_epi32(v, max), max, v);
+        v = select(below, min, v);
+        __m128i n = _mm_add_epi32(_mm_sll_epi32(v, width), half);
+        __m128i even = _mm_srli_epi64(_mm_mul_epu32(n, magic), SERVO_CONVERT_SHIFT);
+        __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), magic), SERVO_CONVERT_SHIFT);
+        __m128i q = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0)),
+                                       _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storeu_si128((__m128i *)(ticks + i), q);
+    }
+    return i;
+}
+
+#else
+
+static int convertVector(const int16_t *, const int *, const int *, uint32_t *, int, int, bool)
+{
+    return 0;   // everything goes through the scalar loop
+}
+
+#endif
+
+static void convert(const int16_t *values, const int *minUs, const int *maxUs,
+                    uint32_t *ticks, int count, int timerWidth, bool angles)
+{
+    int i = convertVector(values, minUs, maxUs, ticks, count, timerWidth, angles);
+    for (; i < count; i++)
+        ticks[i] = convertOne(values[i], minUs[i], maxUs[i], timerWidth, angles);
+}
+
+void servoConvertFrame(const int16_t *values, const int *minUs, const int *maxUs,
+                       uint32_t *ticks, int count, int timerWidth)
+{
+    convert(values, minUs, maxUs, ticks, count, timerWidth, true);
+}
+
+void servoConvertMicroseconds(const int16_t *values, const int *minUs, const int *maxUs,
+                              uint32_t *ticks, int count, int timerWidth)
+{
+    convert(values, minUs, maxUs, ticks, count, timerWidth, false);
+}
+
+int servoConvertKernel()
+{
+    return SERVO_CONVERT_USE;
+}
@@ -0,0 +1,59 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoConvert.h - Batch conversion of servo positions to timer ticks
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Converts whole arrays of positions to PWM ticks at REFRESH_USEC in one
+  call, with exactly the results of Servo::write() / writeMicroseconds()
+  (without backlash compensation) for each element: per element min and
+  max are enforced, and servoUsToTicks() rounding is reproduced bit for
+  bit. Where the compiler targets SSE2 (x86 hosts, for offline tools), four
+  elements are converted at a time; elsewhere, including the ESP32, a
+  scalar loop is used. servoBakeMotion() uses these for every frame.
+
+  The functions are:
+
+    void servoConvertFrame(values, minUs, maxUs, ticks, count, timerWidth)
+        - Converts count values with Servo::write() semantics (below
+        MIN_PULSE_WIDTH are degrees, the rest microseconds).
+    void servoConvertMicroseconds(values, minUs, maxUs, ticks, count,
+        timerWidth) - Converts count pulse widths in microseconds.
+    int servoConvertKernel() - The implementation in use:
+        SERVO_CONVERT_SCALAR or SERVO_CONVERT_SSE2.
+
+  minUs and maxUs hold one limit per element, which must be 0 to 4095
+  microseconds, and timerWidth is 16 to 20.
+ */
+
+#ifndef ServoConvert_h
+#define ServoConvert_h
+
+#include <stdint.h>
+#include "ESP32_Servo.h"
+
+#define SERVO_CONVERT_SCALAR   0
+#define SERVO_CONVERT_SSE2     1
+
+void servoConvertFrame(const int16_t *values, const int *minUs, const int *maxUs,
+                       uint32_t *ticks, int count, int timerWidth);
+void servoConvertMicroseconds(const int16_t *values, const int *minUs, const int *maxUs,
+                              uint32_t *ticks, int count, int timerWidth);
+int servoConvertKernel();
+
+#endif
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The tables are built by the compiler, so the library still compiles as
+* C++11: the curve functions are single expression constexpr functions
+* (sin and 2**x are short series, evaluated in double at compile time) and
+* the 257 samples are expanded from an index pack. Each table is 514 bytes
+* of flash. Samples are 2.14 fixed point, which holds the undershoot of the
+* back and elastic in curves (down to -0.37) with an error of 1/32768; with
+* 256 segments, interpolation keeps the smooth curves within 0.01% of the
+* exact value, elastic within 0.1%, and bounce within 0.3% (at the corners
+* where it hits the target, which fall between samples). The curve shapes
+* are the usual ones (Penner's); the in-out variants are built from the in
+* curve by symmetry.
+*/
+
+#include "ServoEasing.h"
+
+namespace
+{
+
+constexpr double PI = 3.14159265358979323846;
+
+// sin(x) for |x| <= pi, and for larger x after reduction by whole turns
+constexpr double sinSeries(double x2, double term, int n, double sum)
+{
+    return (n > 14) ? sum : sinSeries(x2, -term * x2 / ((2 * n) * (2 * n + 1)), n + 1, sum + term);
+}
+constexpr double reduceTurns(double x)
+{
+    return x - 2 * PI * (double)(long)(x / (2 * PI) + ((x < 0) ? -0.5 : 0.5));
+}
+constexpr double sine(double x)
+{
+    return sinSeries(reduceTurns(x) * reduceTurns(x), reduceTurns(x), 1, 0.0);
+}
+
+// 2**y for -10 <= y <= 0: e**(y ln 2 / 32) from a series, squared five times
+constexpr double expSeries(double x, double term, int n, double sum)
+{
+    return (n > 12) ? sum : expSeries(x, term * x / n, n + 1, sum + term);
+}
+constexpr double square(double x)
+{
+    return x * x;
+}
+constexpr double pow2(double y)
+{
+    return square(square(square(square(square(expSeries(y * 0.69314718055994531 / 32, 1.0, 1, 0.0))))));
+}
+
+constexpr double cubicIn(double t)
+{
+    return t * t * t;
+}
+
+constexpr double backIn(double t)
+{
+    return 2.70158 * t * t * t - 1.70158 * t * t;
+}
+
+constexpr double bounceOut(double t)
+{
+    return (t < 1 / 2.75) ? 7.5625 * t * t :
+           (t < 2 / 2.75) ? 7.5625 * (t - 1.5 / 2.75) * (t - 1.5 / 2.75) + 0.75 :
+           (t < 2.5 / 2.75) ? 7.5625 * (t - 2.25 / 2.75) * (t - 2.25 / 2.75) + 0.9375 :
+           7.5625 * (t - 2.625 / 2.75) * (t - 2.625 / 2.75) + 0.984375;
+}
+constexpr double bounceIn(double t)
+{
+    return 1 - bounceOut(1 - t);
+}
+
+constexpr double elasticIn(double t)
+{
+    return (t <= 0) ? 0 : (t >= 1) ? 1 : -pow2(10 * t - 10) * sine((10 * t - 10.75) * (2 * PI / 3));
+}
+
+#define FAMILY_CUBIC     0
+#define FAMILY_BACK      1
+#define FAMILY_BOUNCE    2
+#define FAMILY_ELASTIC   3
+
+constexpr double curveIn(int family, double t)
+{
+    return (family == FAMILY_CUBIC) ? cubicIn(t) :
+           (family == FAMILY_BACK) ? backIn(t) :
+           (family == FAMILY_BOUNCE) ? bounceIn(t) : elasticIn(t);
+}
+
+constexpr int16_t sample(double v)
+{
+    return (int16_t)(v * 16384 + ((v < 0) ? -0.5 : 0.5));
+}
+
+struct Table
+{
+    int16_t v[SERVO_EASE_SEGMENTS + 1];
+};
+
+template <int... I> struct Indices {};
+template <int N, int... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+template <int... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+template <int... I>
+constexpr Table makeTable(int family, Indices<I...>)
+{
+    return Table{{ sample(curveIn(family, (double)I / SERVO_EASE_SEGMENTS))... }};
+}
+
+constexpr Table makeTable(int family)
+{
+    return makeTable(family, MakeIndices<SERVO_EASE_SEGMENTS + 1>::type());
+}
+
+// the "in" curve of each family, in flash
+constexpr Table tables[4] = {
+    makeTable(FAMILY_CUBIC),
+    makeTable(FAMILY_BACK),
+    makeTable(FAMILY_BOUNCE),
+    makeTable(FAMILY_ELASTIC),
+};
+
+static_assert((tables[FAMILY_CUBIC].v[0] == 0) && (tables[FAMILY_CUBIC].v[SERVO_EASE_SEGMENTS] == 16384),
+              "easing tables must run from 0 to 1");
+
+// "in" curve of a family at t (16.16), interpolated
+long lookup(int family, long t)
+{
+    const int16_t *v = tables[family].v;
+    long index = t >> 8;                                  // 65536 / SERVO_EASE_SEGMENTS
+    if (index >= SERVO_EASE_SEGMENTS)
+        return ((long)v[SERVO_EASE_SEGMENTS] << 2);
+    long a = v[index];
+    long b = v[index + 1];
+    return ((a << 2) + (((b - a) * (t & 255)) >> 6));     // 2.14 -> 16.16
+}
+
+} // namespace
+
+long servoEase(int curve, long t)
+{
+    if (t < 0)
+        t = 0;
+    else if (t > 65536)
+        t = 65536;
+    if ((curve >= SERVO_EASE_CUBIC_IN) && (curve < SERVO_EASE_COUNT))
+    {
+        int family = (curve - SERVO_EASE_CUBIC_IN) / 3;
+        long r = 65536 - t;
+        switch ((curve - SERVO_EASE_CUBIC_IN) % 3)
+        {
+            case 0:
+                return lookup(family, t);
+            case 1:
+                return (65536 - lookup(family, r));
+            default:
+                return ((t < 32768) ? (lookup(family, 2 * t) >> 1) : (65536 - (lookup(family, 2 * r) >> 1)));
+        }
+    }
+    // the same function compiles the tracks of ServoChoreography.h
+    return (servoEaseQuadratic(curve, t));
+}
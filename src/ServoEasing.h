@@ -0,0 +1,84 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoEasing.h - Easing curves for servo moves, from fixed point tables
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  An easing curve maps the elapsed fraction of a move to the fraction of
+  the distance covered. Both are 16.16 fixed point (65536 is the whole
+  move); back and elastic curves go outside 0-65536 as they overshoot.
+
+  The quadratic curves are computed directly, by a constexpr function that
+  ServoChoreography.h also uses, so tracks compiled ahead of time follow
+  exactly the curves of the moves made at run time. The others are looked up in
+  tables of SERVO_EASE_SEGMENTS + 1 samples of the "in" curve, computed at
+  compile time (constexpr) and kept in flash, with linear interpolation
+  between samples; the "out" curve is the "in" curve reversed, and
+  "in-out" is the "in" curve at double speed, then the "out" curve. No
+  floating point is used at run time.
+
+  ServoController::moveTo() takes one of these per move.
+
+  The functions are:
+
+    long servoEase(curve, t) - Eased fraction of a move (16.16) at elapsed
+        fraction t (16.16, clamped to 0-65536); unknown curves are linear.
+    long servoEaseQuadratic(curve, t) - The same for SERVO_EASE_LINEAR,
+        SERVO_EASE_IN, SERVO_EASE_OUT and SERVO_EASE_IN_OUT (others are
+        linear), with t already within 0-65536; constexpr.
+ */
+
+#ifndef ServoEasing_h
+#define ServoEasing_h
+
+#include <stdint.h>
+
+// easing curves for a single move
+#define SERVO_EASE_LINEAR            0
+#define SERVO_EASE_IN                1     // quadratic, slow start
+#define SERVO_EASE_OUT               2     // quadratic, slow finish
+#define SERVO_EASE_IN_OUT            3     // quadratic, slow start and finish
+#define SERVO_EASE_CUBIC_IN          4
+#define SERVO_EASE_CUBIC_OUT         5
+#define SERVO_EASE_CUBIC_IN_OUT      6
+#define SERVO_EASE_BACK_IN           7     // pulls back before starting
+#define SERVO_EASE_BACK_OUT          8     // overshoots, then settles
+#define SERVO_EASE_BACK_IN_OUT       9
+#define SERVO_EASE_BOUNCE_IN        10
+#define SERVO_EASE_BOUNCE_OUT       11     // bounces off the target
+#define SERVO_EASE_BOUNCE_IN_OUT    12
+#define SERVO_EASE_ELASTIC_IN       13
+#define SERVO_EASE_ELASTIC_OUT      14     // springs past the target and rings down
+#define SERVO_EASE_ELASTIC_IN_OUT   15
+#define SERVO_EASE_COUNT            16
+
+#define SERVO_EASE_SEGMENTS        256     // table resolution; samples are 2.14 fixed point
+
+long servoEase(int curve, long t);
+
+// a single expression, so it is constexpr in C++11 too
+constexpr long servoEaseQuadratic(int curve, long t)
+{
+  return (curve == SERVO_EASE_IN) ? (long)(((long long)t * t) >> 16) :
+         (curve == SERVO_EASE_OUT) ? (65536 - (long)(((long long)(65536 - t) * (65536 - t)) >> 16)) :
+         (curve == SERVO_EASE_IN_OUT) ?
+             ((t < 32768) ? (long)((2LL * t * t) >> 16) : (65536 - (long)((2LL * (65536 - t) * (65536 - t)) >> 16))) :
+         t;
+}
+
+#endif
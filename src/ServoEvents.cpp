@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The queue indices run freely and are masked on use, so full and empty
+* are told apart without wasting a slot. The producer publishes an event
+* with a release store of head after writing it, and the consumer frees a
+* slot with a release store of tail after reading it.
+*/
+
+#include "ServoEvents.h"
+
+ServoEventSlots::ServoEventSlots()
+{
+    for (int i = 0; i < SERVO_EVENT_SLOTS; i++)
+    {
+        this->masks[i] = 0;
+        this->callbacks[i] = 0;
+        this->contexts[i] = 0;
+    }
+}
+
+int ServoEventSlots::add(uint16_t typeMask, ServoEventCallback callback, void *context)
+{
+    if (callback == 0)
+        return -1;
+    for (int i = 0; i < SERVO_EVENT_SLOTS; i++)
+    {
+        if (this->callbacks[i] == 0)
+        {
+            this->masks[i] = typeMask;
+            this->contexts[i] = context;
+            this->callbacks[i] = callback;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ServoEventSlots::remove(int slot)
+{
+    if ((slot >= 0) && (slot < SERVO_EVENT_SLOTS))
+    {
+        this->callbacks[slot] = 0;
+        this->masks[slot] = 0;
+    }
+}
+
+void ServoEventSlots::dispatch(const ServoEvent &event)
+{
+    uint16_t bit = SERVO_EVENT_MASK(event.type);
+    for (int i = 0; i < SERVO_EVENT_SLOTS; i++)
+    {
+        if ((this->masks[i] & bit) && (this->callbacks[i] != 0))
+            this->callbacks[i](event, this->contexts[i]);
+    }
+}
+
+ServoEventQueue::ServoEventQueue()
+    : head(0), tail(0), drops(0)
+{
+}
+
+bool ServoEventQueue::push(const ServoEvent &event)
+{
+    uint32_t h = this->head.load(std::memory_order_relaxed);
+    if (h - this->tail.load(std::memory_order_acquire) >= SERVO_EVENT_QUEUE_SIZE)
+    {
+        this->drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    this->events[h & (SERVO_EVENT_QUEUE_SIZE - 1)] = event;
+    this->head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool ServoEventQueue::pop(ServoEvent &event)
+{
+    uint32_t t = this->tail.load(std::memory_order_relaxed);
+    if (t == this->head.load(std::memory_order_acquire))
+        return false;
+    event = this->events[t & (SERVO_EVENT_QUEUE_SIZE - 1)];
+    this->tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+int ServoEventQueue::dropped()
+{
+    return (this->drops.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,104 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoEvents.h - Non-allocating servo event callbacks and event queue
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Events are raised by the frame update (see ServoController.h) and can be
+  delivered two ways, neither of which allocates memory:
+
+  - Immediately, to callbacks registered in a fixed number of slots
+    (ServoEventSlots). A callback is a plain function pointer plus a
+    context pointer, and runs inside the frame update, so it must be short.
+  - Later, through a bounded ServoEventQueue that the frame update pushes
+    into and the application task pops from (one producer, one consumer;
+    safe across the two ESP32 cores). When the queue is full, new events
+    are counted as dropped rather than overwriting older ones.
+
+  The class methods are:
+
+    ServoEventSlots() - Creates an empty set of callback slots.
+    int add(typeMask, callback, context) - Registers callback for the
+        event types whose bits are set in typeMask (SERVO_EVENT_MASK(type));
+        returns the slot number, or -1 if all slots are in use.
+    void remove(slot) - Frees a slot.
+    void dispatch(event) - Calls every callback registered for the event.
+
+    ServoEventQueue() - Creates an empty queue.
+    bool push(event) - Adds an event; returns false (and counts a drop) if
+        the queue is full.
+    bool pop(event) - Removes the oldest event into event; returns false if
+        the queue is empty.
+    int dropped() - Number of events dropped because the queue was full.
+ */
+
+#ifndef ServoEvents_h
+#define ServoEvents_h
+
+#include <stdint.h>
+#include <atomic>
+
+#define SERVO_EVENT_MOTION_COMPLETE   0     // a move reached its target
+#define SERVO_EVENT_LIMIT_REACHED     1     // a target was clamped to min or max
+#define SERVO_EVENT_STALL             2     // feedback disagrees with the commanded position
+#define SERVO_EVENT_MASK(type)        (1U << (type))
+#define SERVO_EVENT_ALL               0xFFFFU
+
+#define SERVO_EVENT_SLOTS             4     // callbacks per ServoEventSlots
+#define SERVO_EVENT_QUEUE_SIZE       32     // events per ServoEventQueue; a power of 2
+
+struct ServoEvent
+{
+  uint8_t type;          // SERVO_EVENT_*
+  uint8_t servo;         // index of the servo in its group
+  int16_t value;         // event specific; a pulse width in microseconds so far
+  uint32_t frame;        // frame number when the event was raised
+};
+
+typedef void (*ServoEventCallback)(const ServoEvent &event, void *context);
+
+class ServoEventSlots
+{
+public:
+  ServoEventSlots();
+  int add(uint16_t typeMask, ServoEventCallback callback, void *context);
+  void remove(int slot);
+  void dispatch(const ServoEvent &event);
+
+  private:
+   uint16_t masks[SERVO_EVENT_SLOTS];
+   ServoEventCallback callbacks[SERVO_EVENT_SLOTS];
+   void *contexts[SERVO_EVENT_SLOTS];
+};
+
+class ServoEventQueue
+{
+public:
+  ServoEventQueue();
+  bool push(const ServoEvent &event);    // producer (frame update) side
+  bool pop(ServoEvent &event);           // consumer (application) side
+  int dropped();
+
+  private:
+   ServoEvent events[SERVO_EVENT_QUEUE_SIZE];
+   std::atomic<uint32_t> head;           // next slot to write; only push() changes it
+   std::atomic<uint32_t> tail;           // next slot to read; only pop() changes it
+   std::atomic<uint32_t> drops;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* As in ServoEventQueue, the indices run freely and are masked on use; the
+* producer publishes a frame with a release store of head after filling
+* it, and the consumer frees one with a release store of tail after
+* writing it out. Frames are filled and read in place, so a frame is
+* copied once, by whoever fills it, rather than into and out of the ring.
+* Each side keeps its last look at the other side's index and reads the
+* shared one again only when that look says the ring is full (producer)
+* or empty (consumer), so in the steady state each frame costs each core
+* one load of the other's index rather than one per call. space() and
+* available() only load the two indices and leave the cached looks alone,
+* so either task may call them. The calling task's own index cannot move
+* between the two loads, so the count is exact for it, if stale as soon as
+* the other task moves; from any other task the indices may move in
+* between, so the count is kept within 0 and the ring size. The two
+* indices are on separate cache lines, for hosts where that matters.
+*/
+
+#include "ServoFrameRing.h"
+
+#define SERVO_FRAME_RING_MASK   (SERVO_FRAME_RING_SIZE - 1)
+
+ServoFrameRing::ServoFrameRing()
+    : head(0), drops(0), tail(0), misses(0), commits(0)
+{
+}
+
+ServoFrame *ServoFrameRing::claim()
+{
+    uint32_t h = this->head.load(std::memory_order_relaxed);
+    if (h - this->tailSeen >= SERVO_FRAME_RING_SIZE)
+    {
+        this->tailSeen = this->tail.load(std::memory_order_acquire);
+        if (h - this->tailSeen >= SERVO_FRAME_RING_SIZE)
+            return 0;
+    }
+    return (&this->frames[h & SERVO_FRAME_RING_MASK]);
+}
+
+void ServoFrameRing::publish()
+{
+    uint32_t h = this->head.load(std::memory_order_relaxed);
+    this->frames[h & SERVO_FRAME_RING_MASK].sequence = this->sequence++;
+    this->head.store(h + 1, std::memory_order_release);
+}
+
+bool ServoFrameRing::push(const uint32_t *ticks, int count)
+{
+    ServoFrame *frame = this->claim();
+    if (frame == 0)
+    {
+        this->drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (count > MAX_SERVOS)
+        count = MAX_SERVOS;
+    for (int i = 0; i < count; i++)
+        frame->ticks[i] = ticks[i];
+    this->publish();
+    return true;
+}
+
+int ServoFrameRing::space()
+{
+    return (SERVO_FRAME_RING_SIZE - this->available());
+}
+
+const ServoFrame *ServoFrameRing::peek()
+{
+    uint32_t t = this->tail.load(std::memory_order_relaxed);
+    if (t == this->headSeen)
+    {
+        this->headSeen = this->head.load(std::memory_order_acquire);
+        if (t == this->headSeen)
+            return 0;
+    }
+    return (&this->frames[t & SERVO_FRAME_RING_MASK]);
+}
+
+void ServoFrameRing::release()
+{
+    this->tail.store(this->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool ServoFrameRing::commit(ServoGroup &group)
+{
+    const ServoFrame *frame = this->peek();
+    if (frame == 0)
+    {
+        // nothing ready at this period boundary: the servos hold the last frame
+        this->misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    group.writeFrame(frame->ticks);
+    this->release();
+    this->commits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+int ServoFrameRing::available()
+{
+    uint32_t t = this->tail.load(std::memory_order_acquire);
+    int queued = (int)(this->head.load(std::memory_order_acquire) - t);
+    if (queued < 0)
+        queued = 0;
+    else if (queued > SERVO_FRAME_RING_SIZE)
+        queued = SERVO_FRAME_RING_SIZE;
+    return queued;
+}
+
+uint32_t ServoFrameRing::dropped()
+{
+    return (this->drops.load(std::memory_order_relaxed));
+}
+
+uint32_t ServoFrameRing::underruns()
+{
+    return (this->misses.load(std::memory_order_relaxed));
+}
+
+uint32_t ServoFrameRing::committed()
+{
+    return (this->commits.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,117 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoFrameRing.h - Frame ring between a planning task and a commit task
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A ServoFrameRing splits the frame loop in two, so that the work of
+  producing frames (ServoController, ServoPlanner, ServoArm, ...) runs on
+  one ESP32 core and writing them to the PWM channels on the other, at
+  the period boundaries, without either waiting for the other:
+
+  - The planning task works on a ServoGroup that has the ring set (see
+    ServoGroup::setFrameRing()); its commit() then queues the whole staged
+    frame in the ring instead of writing the channels. The task keeps at
+    most SERVO_FRAME_RING_SIZE frames ahead by producing a frame only while
+    space() is not 0 (backpressure); a frame committed to a full ring is
+    counted as dropped rather than overwriting a queued one.
+  - The commit task calls commit(group) once per period: it writes the
+    oldest queued frame to the channels (ServoGroup::writeFrame()), or, if
+    none is ready, leaves the servos where they are and counts an
+    underrun. The same task must call Servo::updateAll(), once per period
+    after commit(): updateAll() also writes the servos and their channels
+    (soft start gates, watchdogs and failsafe moves, rate limited writes),
+    and nothing orders it against a commit() on another core. For the same
+    reason, nothing else may write the group's servos while the ring is
+    set.
+
+  The ring is lock free, for one producer and one consumer (as
+  ServoEventQueue). Frames are numbered in the order they are queued. A
+  producer that keeps the ring full runs SERVO_FRAME_RING_SIZE periods
+  ahead of the servos, which is then the latency from planning a frame to
+  its output; a smaller ring trades that against tolerance of planning
+  stalls.
+
+  The class methods are:
+
+    ServoFrameRing() - Creates an empty ring.
+    ServoFrame *claim() - Gets the next free frame for the producer to fill
+        in place, or 0 if the ring is full.
+    void publish() - Queues the frame filled in since claim().
+    bool push(ticks, count) - Queues a frame of count tick values; returns
+        false (and counts a drop) if the ring is full.
+    int space() - Number of frames that can be queued. Either task may call
+        it; the other may change it at any moment.
+    const ServoFrame *peek() - Gets the oldest queued frame, or 0 if the
+        ring is empty.
+    void release() - Frees the frame from peek().
+    bool commit(group) - Writes the oldest queued frame to group and frees
+        it; returns false (and counts an underrun) if there is none.
+    int available() - Number of frames queued. Either task may call it,
+        as space().
+    uint32_t dropped() - Frames dropped because the ring was full.
+    uint32_t underruns() - commit() calls that found no frame.
+    uint32_t committed() - Frames written by commit().
+ */
+
+#ifndef ServoFrameRing_h
+#define ServoFrameRing_h
+
+#include <stdint.h>
+#include <atomic>
+#include "ServoGroup.h"
+
+#ifndef SERVO_FRAME_RING_SIZE
+#define SERVO_FRAME_RING_SIZE   8     // frames; a power of 2
+#endif
+
+struct ServoFrame
+{
+  uint32_t ticks[MAX_SERVOS];    // one per servo, in group order
+  uint32_t sequence;             // numbered by publish(), from 0
+};
+
+class ServoFrameRing
+{
+public:
+  ServoFrameRing();
+  ServoFrame *claim();                       // producer (planning task) side
+  void publish();
+  bool push(const uint32_t *ticks, int count);
+  const ServoFrame *peek();                  // consumer (commit task) side
+  void release();
+  bool commit(ServoGroup &group);
+  int space();                               // either side
+  int available();
+  uint32_t dropped();
+  uint32_t underruns();
+  uint32_t committed();
+
+  private:
+   ServoFrame frames[SERVO_FRAME_RING_SIZE];
+   alignas(64) std::atomic<uint32_t> head;   // next frame to write; only publish() changes it
+   uint32_t tailSeen = 0;                    // the producer's last look at tail; only claim() changes it
+   uint32_t sequence = 0;
+   std::atomic<uint32_t> drops;
+   alignas(64) std::atomic<uint32_t> tail;   // next frame to read; only release() changes it
+   uint32_t headSeen = 0;                    // the consumer's last look at head; only peek() changes it
+   std::atomic<uint32_t> misses;
+   std::atomic<uint32_t> commits;
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The group is a friend of Servo so that commit() and writeFrame() can go
+* straight to Servo::output() (ledcWrite() unless the servo is soft starting),
+* instead of going back through write()/writeMicroseconds() and their
+* conversions for every value. read() and readMicroseconds() report what the
+* group wrote. Values from stageMicroseconds() get the servo's backlash
+* compensation, as writeMicroseconds() does, and those from stageTicks() do
+* not; staged[] holds the commanded value, which the constraints check, and
+* commit() compensates it only for the servos it writes (or, with a ring, for
+* a frame the ring accepted), since compensating moves the servo's direction
+* of travel on.
+* With a frame ring, staged[] belongs to the planning task: commit() queues
+* all of it (every servo, not just the dirty ones, since the commit task
+* writes whole frames) and writeFrame(), called from the commit task,
+* leaves it alone, so the two tasks share only the ring. For the same
+* reason the group keeps its own copy of the last frame queued, which a
+* rejected constraint reverts to; the servos' ticks belong to the commit
+* task and lag the planning task by up to the depth of the ring.
+*/
+
+#include "ServoGroup.h"
+#include "ServoConstraints.h"
+#include "ServoFrameRing.h"
+
+ServoGroup::ServoGroup()
+{
+    for (int i = 0; i < MAX_SERVOS; i++)
+    {
+        this->members[i] = 0;
+        this->staged[i] = 0;
+        this->queued[i] = 0;
+    }
+}
+
+int ServoGroup::add(Servo &servo)
+{
+    if (this->memberCount >= MAX_SERVOS)
+        return -1;
+    this->members[this->memberCount] = &servo;
+    this->staged[this->memberCount] = servo.ticks;
+    this->queued[this->memberCount] = servo.ticks;
+    return (this->memberCount++);
+}
+
+int ServoGroup::count()
+{
+    return (this->memberCount);
+}
+
+Servo *ServoGroup::servo(int index)
+{
+    if ((index < 0) || (index >= this->memberCount))
+        return 0;
+    return (this->members[index]);
+}
+
+void ServoGroup::stageTicks(int index, int ticks)
+{
+    if ((index < 0) || (index >= this->memberCount))
+        return;
+    Servo *s = this->members[index];
+    if (ticks < s->minTicks)          // ensure pulse width is valid
+        ticks = s->minTicks;
+    else if (ticks > s->maxTicks)
+        ticks = s->maxTicks;
+    this->staged[index] = ticks;
+    this->dirty |= (1UL << index);
+    this->backlash &= ~(1UL << index);
+}
+
+void ServoGroup::stageMicroseconds(int index, int value)
+{
+    if ((index < 0) || (index >= this->memberCount))
+        return;
+    Servo *s = this->members[index];
+    if (value < s->min)
+        value = s->min;
+    else if (value > s->max)
+        value = s->max;
+    this->staged[index] = s->usToTicks(value);
+    this->dirty |= (1UL << index);
+    this->backlash |= (1UL << index);
+}
+
+int ServoGroup::readStagedTicks(int index)
+{
+    if ((index < 0) || (index >= this->memberCount))
+        return 0;
+    if ((this->dirty & (1UL << index)) || this->ring)
+        return (this->staged[index]);
+    return (this->members[index]->ticks);
+}
+
+void ServoGroup::setConstraints(ServoConstraints *constraints)
+{
+    this->constraints = constraints;
+}
+
+void ServoGroup::setFrameRing(ServoFrameRing *ring)
+{
+    this->ring = ring;
+}
+
+// puts a servo back where the last commit() left it; not a write, so
+// commit() leaves the channel (and the servo's watchdog) alone
+void ServoGroup::revert(int index)
+{
+    uint32_t bit = 1UL << index;
+    if (this->ring)
+    {
+        this->staged[index] = this->queued[index];
+        this->backlash = (this->backlash & ~bit) | (this->queuedBacklash & bit);
+    }
+    else
+    {
+        this->staged[index] = this->members[index]->ticks;
+        this->dirty &= ~bit;
+        this->backlash &= ~bit;
+    }
+}
+
+void ServoGroup::restage(int index, int ticks)
+{
+    this->staged[index] = ticks;
+    this->dirty |= (1UL << index);
+}
+
+void ServoGroup::commit()
+{
+    if (this->constraints)
+        this->constraints->apply(*this);
+    if (this->ring)
+    {
+        // the commit task writes it, at its period boundary
+        uint32_t frame[MAX_SERVOS];
+        for (int i = 0; i < this->memberCount; i++)
+        {
+            Servo *s = this->members[i];
+            frame[i] = this->staged[i];
+            if (this->backlash & (1UL << i))
+                frame[i] = s->usToTicks(s->backlash(s->ticksToUs(this->staged[i])));
+        }
+        this->dirty = 0;
+        if (this->ring->push(frame, this->memberCount))
+        {
+            for (int i = 0; i < this->memberCount; i++)
+            {
+                Servo *s = this->members[i];
+                if (this->backlash & (1UL << i))
+                    s->track(s->ticksToUs(this->staged[i]));
+                this->queued[i] = this->staged[i];
+            }
+            this->queuedBacklash = this->backlash;
+        }
+        return;
+    }
+    uint32_t pending = this->dirty;
+    uint32_t compensated = this->backlash;
+    this->dirty = 0;
+    for (int i = 0; pending != 0; i++, pending >>= 1, compensated >>= 1)
+    {
+        Servo *s = this->members[i];
+        if ((pending & 1) && s->attached())
+        {
+            if (compensated & 1)
+                s->output(s->usToTicks(s->compensate(s->ticksToUs(this->staged[i]))));
+            else
+                s->output(this->staged[i]);
+        }
+    }
+}
+
+void ServoGroup::writeFrame(const uint32_t *ticks)
+{
+    for (int i = 0; i < this->memberCount; i++)
+    {
+        Servo *s = this->members[i];
+        if (!this->ring)
+            this->staged[i] = ticks[i];
+        if (s->attached())
+            s->output(ticks[i]);
+    }
+    if (!this->ring)
+    {
+        this->dirty = 0;
+        this->backlash = 0;
+    }
+}
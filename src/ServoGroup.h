@@ -0,0 +1,98 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoGroup.h - Batched updates for a set of ESP32 servos
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A ServoGroup collects up to MAX_SERVOS attached Servo instances so that a
+  whole frame can be staged first and then written to the PWM channels in
+  one pass. Servos are referred to by their index in the group (the order
+  in which they were added).
+
+  The class methods are:
+
+    ServoGroup() - Creates an empty group.
+    int add(servo) - Adds a servo; returns its index in the group, or -1 if
+        the group is full.
+    int count() - Gets the number of servos in the group.
+    Servo *servo(index) - Gets the servo at index (0 if out of range).
+    void stageTicks(index, ticks) - Stages a pulse width in timer ticks;
+        the servo's min and max are enforced.
+    void stageMicroseconds(index, value) - Stages a pulse width in
+        microseconds; min and max are enforced, and the servo's backlash
+        compensation (see Servo::setBacklash()) is applied when commit()
+        writes or queues the value, so a value that is never written does
+        not change the servo's direction of travel.
+    int readStagedTicks(index) - Gets the staged ticks (before backlash
+        compensation), or the servo's current ticks if nothing is staged
+        for it (with a frame ring set, always the ticks last staged).
+    void commit() - Writes every staged value to its channel, after
+        checking the constraints (if any); with a frame ring set, queues
+        the whole frame in the ring instead.
+    void writeFrame(ticks) - Writes one tick value per servo straight to the
+        channels, in group order (skipping servos that are not attached, as
+        commit() does). No limits are applied; the values are
+        expected to come from servoBakeMotion() or a frame ring, which
+        enforce them.
+    void setConstraints(constraints) - Sets a table of joint interference
+        limits that commit() checks first (see ServoConstraints.h).
+    void setFrameRing(ring) - Makes commit() queue frames in ring for
+        another task to write (see ServoFrameRing.h); 0 to write them
+        directly again.
+ */
+
+#ifndef ServoGroup_h
+#define ServoGroup_h
+
+#include <stdint.h>
+#include "ESP32_Servo.h"
+
+class ServoConstraints;
+class ServoFrameRing;
+
+class ServoGroup
+{
+public:
+  ServoGroup();
+  int add(Servo &servo);                   // returns the index in the group, or -1 if full
+  int count();
+  Servo *servo(int index);
+  void stageTicks(int index, int ticks);   // limits are enforced when staging
+  void stageMicroseconds(int index, int value);
+  int readStagedTicks(int index);
+  void commit();                           // write all staged values
+  void writeFrame(const uint32_t *ticks);  // raw frame, one value per servo; no limits applied
+  void setConstraints(ServoConstraints *constraints);   // checked at every commit(); 0 for none
+  void setFrameRing(ServoFrameRing *ring);              // commit() queues frames there; 0 for none
+
+  private:
+   friend class ServoConstraints;          // rejected frames are reverted with revert(), clamps use restage()
+   void revert(int index);
+   void restage(int index, int ticks);     // a clamp: keeps the value's backlash compensation
+   Servo *members[MAX_SERVOS];
+   uint32_t staged[MAX_SERVOS];            // ticks waiting for commit()
+   uint32_t queued[MAX_SERVOS];            // with a frame ring, the last frame queued in it
+   uint32_t dirty = 0;                     // bit n set if staged[n] has not been written
+   uint32_t backlash = 0;                  // bit n set if staged[n] is compensated when written
+   uint32_t queuedBacklash = 0;            // the same, for queued[]
+   int memberCount = 0;
+   ServoConstraints *constraints = 0;
+   ServoFrameRing *ring = 0;               // set when another task writes the frames
+};
+
+#endif
@@ -0,0 +1,158 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoMath.h - Integer arithmetic shared by the motion classes
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Internal to the library. Where a device class and an offline converter
+  (or two device classes) must compute exactly the same thing, the
+  arithmetic is here, once, as inline functions: reading a value the way
+  Servo::write() does, and the speed limits of ServoPlanner, which
+  servoRetimeMotion() reproduces offline. Everything is integer and uses
+  nothing from the Arduino core, so the offline converters still build on
+  a host.
+
+  The functions are:
+
+    int64_t servoSqrt(x) - floor(sqrt(x)) for x >= 0.
+    int servoAngleToUs(value, min, max) - value as Servo::write() takes it:
+        below MIN_PULSE_WIDTH, degrees (0 to 180) mapped onto min to max;
+        otherwise microseconds, returned unchanged.
+    int servoTargetUs(value, min, max) - servoAngleToUs(), then clamped to
+        min and max, as writeMicroseconds() does.
+    int32_t servoReachSpeed(arrival, accel, distance) - The fastest speed
+        (24.8) from which steps shrinking by accel reach arrival within
+        distance.
+    int32_t servoMoveLength(delta, count) - Euclidean length (24.8) of a
+        move that changes count servos by delta[] microseconds.
+    void servoMoveLimits(delta, count, length, maxSpeed, maxAccel, cap,
+        speed, accel) - Speed (at most cap) and acceleration along a move
+        (24.8) at which no servo passes its maxSpeed and half its maxAccel.
+    int32_t servoJunctionSpeed(before, beforeLength, delta, length, count,
+        maxAccel, limit) - Speed (at most limit) at which no servo's
+        velocity changes by more than half its maxAccel where the move by
+        before[] turns into the move by delta[].
+ */
+
+#ifndef ServoMath_h
+#define ServoMath_h
+
+#include <stdint.h>
+#include "ESP32_Servo.h"      // MIN_PULSE_WIDTH
+
+inline int64_t servoSqrt(int64_t x)
+{
+  int64_t root = 0;
+  int64_t bit = (int64_t)1 << 62;
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0)
+  {
+    if (x >= root + bit)
+    {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+    bit >>= 2;
+  }
+  return root;
+}
+
+inline int servoAngleToUs(int value, int min, int max)
+{
+  if (value < MIN_PULSE_WIDTH)
+  {
+    if (value < 0)
+      value = 0;
+    else if (value > 180)
+      value = 180;
+    value = (long)value * (max - min) / 180 + min;
+  }
+  return value;
+}
+
+inline int servoTargetUs(int value, int min, int max)
+{
+  value = servoAngleToUs(value, min, max);
+  if (value < min)
+    value = min;
+  else if (value > max)
+    value = max;
+  return value;
+}
+
+inline int32_t servoReachSpeed(int32_t arrival, int32_t accel, int32_t distance)
+{
+  int64_t half = accel / 2;
+  return ((int32_t)(servoSqrt((int64_t)arrival * arrival + 2 * (int64_t)accel * distance + half * half) - half));
+}
+
+template <typename Delta>
+inline int32_t servoMoveLength(const Delta *delta, int count)
+{
+  int64_t sum = 0;
+  for (int i = 0; i < count; i++)
+    sum += (int64_t)delta[i] * delta[i];
+  return ((int32_t)servoSqrt(sum << 16));
+}
+
+// the servo that would go over its limits first sets them along the path
+template <typename Delta, typename Limit>
+inline void servoMoveLimits(const Delta *delta, int count, int32_t length, const Limit *maxSpeed,
+                            const Limit *maxAccel, int64_t cap, int32_t *speed, int32_t *accel)
+{
+  int64_t fastest = cap;
+  int64_t slowest = INT32_MAX;
+  for (int i = 0; i < count; i++)
+  {
+    int64_t d = (delta[i] < 0) ? -delta[i] : delta[i];
+    if (d == 0)
+      continue;
+    int64_t v = (int64_t)maxSpeed[i] * length / d;
+    int64_t a = (int64_t)maxAccel[i] * length / (2 * d);
+    if (v < fastest)
+      fastest = v;
+    if (a < slowest)
+      slowest = a;
+  }
+  *speed = (fastest > 0) ? (int32_t)fastest : 1;
+  *accel = (slowest > 0) ? (int32_t)slowest : 1;
+}
+
+// maxAccel[i] / 2 / |before[i]/beforeLength - delta[i]/length|, without division until the end
+template <typename Delta, typename Limit>
+inline int32_t servoJunctionSpeed(const Delta *before, int32_t beforeLength, const Delta *delta, int32_t length,
+                                  int count, const Limit *maxAccel, int64_t limit)
+{
+  for (int i = 0; i < count; i++)
+  {
+    int64_t turn = (int64_t)before[i] * length - (int64_t)delta[i] * beforeLength;
+    if (turn < 0)
+      turn = -turn;
+    if (turn == 0)
+      continue;
+    int64_t v = (int64_t)maxAccel[i] * beforeLength * length / (2 * turn);
+    if (v < limit)
+      limit = v;
+  }
+  return ((int32_t)limit);
+}
+
+#endif
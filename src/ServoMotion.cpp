@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* All checking happens once, in load(); playFrame() only indexes into the
+* motion and hands the frame to ServoGroup::writeFrame().
+*/
+
+#include "ServoMotion.h"
+
+ServoMotionPlayer::ServoMotionPlayer(ServoGroup &group)
+{
+    this->group = &group;
+}
+
+bool ServoMotionPlayer::load(const uint32_t *motion)
+{
+    const ServoMotionHeader *header = (const ServoMotionHeader *)motion;
+    this->frames = 0;
+    this->frameCount = 0;
+    this->frame = 0;
+    if ((header->magic != SERVO_MOTION_MAGIC) || (header->version != SERVO_MOTION_VERSION))
+        return false;
+    if ((header->channels != this->group->count()) || (header->refreshHz != REFRESH_CPS))
+        return false;
+    for (int i = 0; i < header->channels; i++)
+    {
+        if (this->group->servo(i)->readTimerWidth() != header->timerWidth)
+            return false;
+    }
+    this->frames = motion + SERVO_MOTION_HEADER_WORDS;
+    this->channels = header->channels;
+    this->frameCount = header->frameCount;
+    return true;
+}
+
+bool ServoMotionPlayer::playFrame()
+{
+    if (this->frame >= this->frameCount)
+        return false;
+    this->group->writeFrame(this->frames + (this->frame * this->channels));
+    this->frame++;
+    return true;
+}
+
+void ServoMotionPlayer::seek(int frame)
+{
+    if (frame < 0)
+        frame = 0;
+    else if (frame > this->frameCount)
+        frame = this->frameCount;
+    this->frame = frame;
+}
+
+int ServoMotionPlayer::readFrame()
+{
+    return (this->frame);
+}
+
+int ServoMotionPlayer::length()
+{
+    return (this->frameCount);
+}
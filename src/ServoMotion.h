@@ -0,0 +1,109 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoMotion.h - Precompiled (baked) tick streams for groups of ESP32 servos
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A baked motion is a ServoMotionHeader followed by frameCount frames of
+  channels tick values (uint32_t, frame after frame). The ticks are already
+  converted and limited for one timer width and refresh rate, so playing a
+  frame is just one ledcWrite() per channel (ServoGroup::writeFrame()).
+
+  servoBakeMotion() does the conversion offline; it uses only the C library,
+  so it can be built into a host tool that writes the motion as a C array or
+  a data file. Input values follow Servo::write(): values below
+  MIN_PULSE_WIDTH are degrees, the rest are microseconds.
+
+  The class methods are:
+
+    ServoMotionPlayer(group) - Creates a player for the given group.
+    bool load(motion) - Loads a baked motion (not copied, so it may live in
+        flash); returns false if the header is invalid or does not match the
+        group (channel count, timer width of every servo, REFRESH_CPS).
+    bool playFrame() - Writes the next frame; returns false at the end.
+    void seek(frame) - Sets the next frame to play.
+    int readFrame() - Gets the index of the next frame to play.
+    int length() - Gets the number of frames in the loaded motion.
+
+    int servoBakeMotion(values, frameCount, channels, minUs, maxUs,
+        timerWidth, refreshHz, out, maxWords) - Converts frameCount frames of
+        channels values (with per channel min/max in microseconds) into a
+        baked motion in out; returns the number of uint32_t words written,
+        or -1 if out is too small or a parameter is invalid.
+    int servoMotionWords(frameCount, channels) - Words needed for a motion.
+    int servoRetimeMotion(keys, keyCount, channels, minUs, maxUs, maxSpeed,
+        maxAccel, entries, values, maxFrames) - Retimes keyCount keyframes
+        of channels values (as for servoBakeMotion()) into the fewest frames
+        that pass through every keyframe, starting and ending at rest,
+        without any channel moving faster than maxSpeed or changing speed
+        by more than maxAccel (microseconds per frame, and per frame per
+        frame; ServoPlanner's limits). entries is workspace for keyCount
+        values. Writes the frames to values (microseconds, ready for
+        servoBakeMotion()) and returns their number, or -1 if maxFrames is
+        too small or a parameter is invalid; with values 0, only counts the
+        frames.
+ */
+
+#ifndef ServoMotion_h
+#define ServoMotion_h
+
+#include <stdint.h>
+#include "ServoGroup.h"
+
+#define SERVO_MOTION_MAGIC    0x4D565253UL   // "SRVM" in little endian
+#define SERVO_MOTION_VERSION  1
+
+struct ServoMotionHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t channels;
+  uint16_t timerWidth;
+  uint16_t refreshHz;
+  uint32_t frameCount;
+};
+
+#define SERVO_MOTION_HEADER_WORDS  (sizeof(ServoMotionHeader) / sizeof(uint32_t))
+
+class ServoMotionPlayer
+{
+public:
+  ServoMotionPlayer(ServoGroup &group);
+  bool load(const uint32_t *motion);    // motion is used in place, not copied
+  bool playFrame();                     // returns false at the end of the motion
+  void seek(int frame);
+  int readFrame();
+  int length();
+
+  private:
+   ServoGroup *group;
+   const uint32_t *frames = 0;          // first frame, just past the header
+   int channels = 0;
+   int frameCount = 0;
+   int frame = 0;                       // next frame to play
+};
+
+int servoMotionWords(int frameCount, int channels);
+int servoBakeMotion(const int16_t *values, int frameCount, int channels,
+                    const int *minUs, const int *maxUs, int timerWidth, int refreshHz,
+                    uint32_t *out, int maxWords);
+int servoRetimeMotion(const int16_t *keys, int keyCount, int channels,
+                      const int *minUs, const int *maxUs, const int *maxSpeed, const int *maxAccel,
+                      int32_t *entries, int16_t *values, int maxFrames);
+
+#endif
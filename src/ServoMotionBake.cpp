@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The conversion is the same as Servo::write() followed by
+* Servo::writeMicroseconds(): clamp degrees to 0-180, map them onto min-max,
+* clamp microseconds to min-max, then servoUsToTicks() with the target PWM
+* period. It uses no Arduino calls, so it can be compiled on a host.
+* At REFRESH_USEC the frames go through servoConvertFrame(), which does the
+* same conversion for a whole frame at a time.
+*/
+
+#include "ServoMotion.h"
+#include "ServoConvert.h"
+#include "ServoMath.h"
+
+int servoMotionWords(int frameCount, int channels)
+{
+    return (SERVO_MOTION_HEADER_WORDS + (frameCount * channels));
+}
+
+int servoBakeMotion(const int16_t *values, int frameCount, int channels,
+                    const int *minUs, const int *maxUs, int timerWidth, int refreshHz,
+                    uint32_t *out, int maxWords)
+{
+    if ((channels <= 0) || (channels > MAX_SERVOS) || (frameCount < 0))
+        return -1;
+    if ((timerWidth < 16) || (timerWidth > 20) || (refreshHz <= 0))
+        return -1;
+    int words = servoMotionWords(frameCount, channels);
+    if (words > maxWords)
+        return -1;
+
+    ServoMotionHeader *header = (ServoMotionHeader *)out;
+    header->magic = SERVO_MOTION_MAGIC;
+    header->version = SERVO_MOTION_VERSION;
+    header->channels = channels;
+    header->timerWidth = timerWidth;
+    header->refreshHz = refreshHz;
+    header->frameCount = frameCount;
+
+    int refreshUsec = 1000000 / refreshHz;
+    uint32_t *ticks = out + SERVO_MOTION_HEADER_WORDS;
+    bool batch = (refreshUsec == REFRESH_USEC);
+    for (int c = 0; c < channels; c++)
+    {
+        if ((minUs[c] < 0) || (maxUs[c] < 0) || (minUs[c] > 4095) || (maxUs[c] > 4095))
+            batch = false;
+    }
+    if (batch)
+    {
+        // the usual case: whole frames at once, same results (see ServoConvert.cpp)
+        for (int f = 0; f < frameCount; f++, values += channels, ticks += channels)
+            servoConvertFrame(values, minUs, maxUs, ticks, channels, timerWidth);
+        return words;
+    }
+    for (int f = 0; f < frameCount; f++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            // degrees or microseconds, as in Servo::write()
+            int value = servoTargetUs(*values++, minUs[c], maxUs[c]);
+            *ticks++ = servoUsToTicks(value, timerWidth, refreshUsec);
+        }
+    }
+    return words;
+}
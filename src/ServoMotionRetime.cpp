@@ -0,0 +1,216 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The limit model is ServoPlanner's (see ServoPlanner.cpp), computed by
+* the same functions (ServoMath.h): each move between keyframes gets the
+* speed and acceleration along the path that keep every channel within its
+* limits, each junction the speed at which no channel's velocity changes
+* by more than half its acceleration as the path turns, and the frames are
+* stepped exactly as ServoPlanner::update() steps them, in the same 24.8
+* fixed point. What the device planner cannot do is look further ahead
+* than its buffer; here the backward pass runs from the last keyframe to
+* the first, so every junction is crossed as fast as the limits allow
+* anywhere later in the motion, and the frame count is the least the model
+* allows. A repeated keyframe is a move of length 0, where the motion
+* stops.
+* Only the planned entry speed of each move is kept (in entries); the
+* rest is recomputed from the keyframes when needed, so a 10000 keyframe
+* motion needs 40 KB of workspace besides its frames. Like the other
+* offline converters this uses only the C library, for use in host tools.
+*/
+
+#include "ServoMotion.h"
+#include "ServoMath.h"
+
+namespace
+{
+
+struct Path
+{
+    const int16_t *keys;
+    int channels;
+    const int *minUs;
+    const int *maxUs;
+    const int *maxSpeed;
+    const int *maxAccel;
+};
+
+// along the move that ends at a keyframe, 24.8 fixed point
+struct Move
+{
+    int32_t length;
+    int32_t maxSpeed;
+    int32_t accel;
+    int32_t maxEntry;
+};
+
+// keyframe value in microseconds, as in Servo::write()
+int keyUs(const Path &path, int key, int c)
+{
+    return (servoTargetUs(path.keys[key * path.channels + c], path.minUs[c], path.maxUs[c]));
+}
+
+int32_t lengthOf(const Path &path, int key, int *delta)
+{
+    for (int c = 0; c < path.channels; c++)
+        delta[c] = keyUs(path, key, c) - keyUs(path, key - 1, c);
+    return (servoMoveLength(delta, path.channels));
+}
+
+// the move from keyframe key - 1 to key (key >= 1), as ServoPlanner::add()
+void measure(const Path &path, int key, Move *move)
+{
+    int delta[MAX_SERVOS];
+    int before[MAX_SERVOS];
+    move->length = lengthOf(path, key, delta);
+    move->maxEntry = 0;
+    if (move->length == 0)
+    {
+        move->maxSpeed = 0;
+        move->accel = 1;
+        return;
+    }
+    servoMoveLimits(delta, path.channels, move->length, path.maxSpeed, path.maxAccel, INT32_MAX,
+                    &move->maxSpeed, &move->accel);
+
+    // from rest at the first keyframe, and after a repeated one
+    if (key < 2)
+        return;
+    int32_t length = lengthOf(path, key - 1, before);
+    if (length == 0)
+        return;
+    int32_t beforeSpeed;
+    int32_t beforeAccel;
+    servoMoveLimits(before, path.channels, length, path.maxSpeed, path.maxAccel, INT32_MAX,
+                    &beforeSpeed, &beforeAccel);
+    move->maxEntry = servoJunctionSpeed(before, length, delta, move->length, path.channels, path.maxAccel,
+                                        (move->maxSpeed < beforeSpeed) ? move->maxSpeed : beforeSpeed);
+}
+
+void emit(const Path &path, int key, int32_t fraction, int16_t *frame)
+{
+    for (int c = 0; c < path.channels; c++)
+    {
+        int32_t from = keyUs(path, key - 1, c);
+        int32_t delta = keyUs(path, key, c) - from;
+        frame[c] = (int16_t)(((from << 8) + (int32_t)(((int64_t)delta * fraction) >> 16) + 128) >> 8);
+    }
+}
+
+} // namespace
+
+int servoRetimeMotion(const int16_t *keys, int keyCount, int channels,
+                      const int *minUs, const int *maxUs, const int *maxSpeed, const int *maxAccel,
+                      int32_t *entries, int16_t *values, int maxFrames)
+{
+    if ((channels <= 0) || (channels > MAX_SERVOS) || (keyCount <= 0))
+        return -1;
+    for (int c = 0; c < channels; c++)
+    {
+        if ((minUs[c] < 0) || (maxUs[c] < minUs[c]) || (maxUs[c] > 0x7FFF))
+            return -1;
+        if ((maxSpeed[c] < 1) || (maxSpeed[c] > 0x7FFF) || (maxAccel[c] < 1) || (maxAccel[c] > 0x7FFF))
+            return -1;
+    }
+    Path path = { keys, channels, minUs, maxUs, maxSpeed, maxAccel };
+    Move move;
+
+    // backwards from rest at the end, then forwards from rest at the start
+    entries[0] = 0;
+    int32_t next = 0;
+    for (int k = keyCount - 1; k >= 1; k--)
+    {
+        measure(path, k, &move);
+        int32_t reach = (move.length == 0) ? 0 : servoReachSpeed(next, move.accel, move.length);
+        entries[k] = (reach < move.maxEntry) ? reach : move.maxEntry;
+        next = entries[k];
+    }
+    for (int k = 2; k < keyCount; k++)
+    {
+        measure(path, k - 1, &move);
+        int32_t reach = (move.length == 0) ? 0 : servoReachSpeed(entries[k - 1], move.accel, move.length);
+        if (entries[k] > reach)
+            entries[k] = reach;
+    }
+
+    // then frame by frame, as ServoPlanner::update()
+    int frames = 0;
+    if (values)
+    {
+        if (maxFrames < 1)
+            return -1;
+        for (int c = 0; c < channels; c++)
+            values[c] = (int16_t)keyUs(path, 0, c);
+    }
+    frames++;
+    int key = 1;
+    int32_t distance = 0;
+    int32_t speed = 0;
+    if (keyCount > 1)
+        measure(path, key, &move);
+    while (key < keyCount)
+    {
+        if (move.length == 0)
+        {
+            // a repeated keyframe: nothing to step
+            if (++key < keyCount)
+                measure(path, key, &move);
+            continue;
+        }
+        int32_t arrival = (key + 1 < keyCount) ? entries[key + 1] : 0;
+        int32_t step = speed + move.accel;
+        if (step > move.maxSpeed)
+            step = move.maxSpeed;
+        if ((distance == 0) && (step > entries[key]) && (speed > entries[key]))
+            step = entries[key];
+        int32_t remaining = move.length - distance;
+        int32_t braking = servoReachSpeed(arrival, move.accel, (remaining > arrival) ? remaining - arrival : 0);
+        if (step > braking)
+            step = braking;
+        if ((step > remaining) && (step > arrival))
+            step = (remaining > arrival) ? remaining : arrival;
+        if (step < 1)
+            step = 1;
+        speed = step;
+        distance += step;
+        // the rest of the step goes on into the next move
+        while ((key < keyCount) && (distance >= move.length))
+        {
+            distance -= move.length;
+            if (++key < keyCount)
+                measure(path, key, &move);
+            else
+                distance = 0;
+        }
+        if (values)
+        {
+            if (frames >= maxFrames)
+                return -1;
+            int16_t *frame = values + frames * channels;
+            if (key < keyCount)
+                emit(path, key, (int32_t)(((int64_t)distance << 24) / move.length), frame);
+            else
+            {
+                for (int c = 0; c < channels; c++)
+                    frame[c] = (int16_t)keyUs(path, keyCount - 1, c);
+            }
+        }
+        frames++;
+    }
+    return frames;
+}
@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* On the ESP32 the whole partition is mapped as data with
+* esp_partition_mmap(); the MMU maps flash in 64KB pages, and reads go
+* through the flash cache. The mmap call and handle type were renamed in
+* ESP-IDF 5, hence the version check.
+*
+* Prefetching only moves forward: each call reads one byte from every cache
+* line between the last prefetched offset and offset + lookahead. A seek
+* backwards (or a jump forwards past the lookahead) restarts it from the
+* new offset.
+*/
+
+#include "ServoPartition.h"
+
+#if defined(ESP_PLATFORM)
+#include "esp_partition.h"
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION_MAJOR >= 5
+#define SERVO_MMAP_DATA    ESP_PARTITION_MMAP_DATA
+typedef esp_partition_mmap_handle_t servo_mmap_handle_t;
+#define servo_munmap       esp_partition_munmap
+#else
+#include "esp_spi_flash.h"
+#define SERVO_MMAP_DATA    SPI_FLASH_MMAP_DATA
+typedef spi_flash_mmap_handle_t servo_mmap_handle_t;
+#define servo_munmap       spi_flash_munmap
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// prefetch reads land here so the compiler cannot drop them
+static volatile uint8_t prefetchSink;
+
+ServoPartition::ServoPartition()
+{
+}
+
+ServoPartition::~ServoPartition()
+{
+    this->close();
+}
+
+bool ServoPartition::open(const char *label)
+{
+    this->close();
+#if defined(ESP_PLATFORM)
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == 0)
+        return false;
+    const void *mapped;
+    servo_mmap_handle_t handle;
+    if (esp_partition_mmap(partition, 0, partition->size, SERVO_MMAP_DATA, &mapped, &handle) != ESP_OK)
+        return false;
+    this->handle = handle;
+    this->length = partition->size;
+#else
+    int fd = ::open(label, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || (info.st_size == 0))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *mapped = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+    this->handle = fd;
+    this->length = info.st_size;
+#endif
+    this->base = (const uint8_t *)mapped;
+    this->prefetched = 0;
+    return true;
+}
+
+void ServoPartition::close()
+{
+    if (this->base == 0)
+        return;
+#if defined(ESP_PLATFORM)
+    servo_munmap((servo_mmap_handle_t)this->handle);
+#else
+    munmap((void *)this->base, this->length);
+    ::close((int)this->handle);
+#endif
+    this->base = 0;
+    this->length = 0;
+}
+
+const uint8_t *ServoPartition::data()
+{
+    return (this->base);
+}
+
+uint32_t ServoPartition::size()
+{
+    return (this->length);
+}
+
+const uint32_t *ServoPartition::motion()
+{
+    if ((this->base == 0) || (this->length < sizeof(ServoMotionHeader)))
+        return 0;
+    const ServoMotionHeader *header = (const ServoMotionHeader *)this->base;
+    if ((header->magic != SERVO_MOTION_MAGIC) || (header->version != SERVO_MOTION_VERSION))
+        return 0;
+    uint64_t bytes = sizeof(ServoMotionHeader) + (uint64_t)header->frameCount * header->channels * 4;
+    if (bytes > this->length)
+        return 0;
+    return ((const uint32_t *)this->base);
+}
+
+void ServoPartition::prefetchOffset(uint32_t offset)
+{
+    if (this->base == 0)
+        return;
+    if ((offset + this->lookahead + SERVO_PARTITION_LINE < this->prefetched) || (offset > this->prefetched))
+    {
+        // seek: start over from here
+        this->prefetched = offset & ~(uint32_t)(SERVO_PARTITION_LINE - 1);
+    }
+    uint32_t target = offset + this->lookahead;
+    if (target > this->length)
+        target = this->length;
+    while (this->prefetched < target)
+    {
+        prefetchSink = this->base[this->prefetched];
+        this->prefetched += SERVO_PARTITION_LINE;
+    }
+}
+
+void ServoPartition::prefetchFrame(int frame)
+{
+    if ((this->base == 0) || (frame < 0))
+        return;
+    const ServoMotionHeader *header = (const ServoMotionHeader *)this->base;
+    this->prefetchOffset(sizeof(ServoMotionHeader) + (uint32_t)frame * header->channels * 4);
+}
+
+void ServoPartition::setLookahead(uint32_t bytes)
+{
+    this->lookahead = bytes;
+    this->prefetched = 0;
+}
@@ -0,0 +1,84 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoPartition.h - Motion data read in place from a flash data partition
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Large shows do not fit in RAM, and reading them through a file system
+  costs a copy and a call for every frame. ServoPartition maps a flash data
+  partition into the address space instead, so a ServoMotionPlayer (or a
+  ServoMotionDecoder, for compressed shows) reads frames in place.
+
+  Mapped flash is read through the flash cache; the first read of a cache
+  line that is not loaded stalls while it is fetched from flash. Calling
+  prefetchFrame() from loop() reads ahead of the player, one cache line at a
+  time, so those stalls happen between frames rather than during a commit.
+
+  On a host build (no ESP_PLATFORM), open() maps the file named label, so
+  players and tools can be exercised on a PC with the same code.
+
+  The class methods are:
+
+    ServoPartition() - Creates an unopened partition.
+    bool open(label) - Maps the data partition (or host file) with this
+        label; returns false if it does not exist or cannot be mapped.
+    void close() - Unmaps the partition.
+    const uint8_t *data() - Start of the mapped data (0 if not open).
+    uint32_t size() - Size of the mapped data in bytes.
+    const uint32_t *motion() - The data as a baked motion (for
+        ServoMotionPlayer::load()), or 0 if it does not start with a valid
+        motion header or is shorter than the motion.
+    void prefetchOffset(offset) - Reads ahead up to offset + the lookahead.
+    void prefetchFrame(frame) - As prefetchOffset(), for frame of a baked
+        motion.
+    void setLookahead(bytes) - How far ahead to read (default
+        SERVO_PARTITION_LOOKAHEAD).
+ */
+
+#ifndef ServoPartition_h
+#define ServoPartition_h
+
+#include <stdint.h>
+#include "ServoMotion.h"
+
+#define SERVO_PARTITION_LINE        32     // flash cache line size in bytes
+#define SERVO_PARTITION_LOOKAHEAD  1024    // default read ahead in bytes
+
+class ServoPartition
+{
+public:
+  ServoPartition();
+  ~ServoPartition();
+  bool open(const char *label);
+  void close();
+  const uint8_t *data();
+  uint32_t size();
+  const uint32_t *motion();
+  void prefetchOffset(uint32_t offset);
+  void prefetchFrame(int frame);
+  void setLookahead(uint32_t bytes);
+
+  private:
+   const uint8_t *base = 0;
+   uint32_t length = 0;
+   uint32_t lookahead = SERVO_PARTITION_LOOKAHEAD;
+   uint32_t prefetched = 0;              // everything below this offset has been read
+   uint32_t handle = 0;                  // mmap handle (ESP32) or file descriptor (host)
+};
+
+#endif
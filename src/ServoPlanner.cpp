@@ -0,0 +1,250 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* A move of length L changes servo i by d[i], so at speed v along the path
+* that servo moves at v * |d[i]| / L; the speed allowed along a move is the
+* smallest of maxSpeed[i] * L / |d[i]|. At a junction the direction changes
+* from d1/L1 to d2/L2 within a frame, which changes the velocity of servo i
+* by up to v * |d1[i]/L1 - d2[i]/L2| (split over the frame that crosses the
+* junction and the next). Those frames may also be speeding up or slowing
+* down, so each effect gets half of maxAccel[i]: the acceleration along a
+* move is the smallest of maxAccel[i] / 2 * L / |d[i]|, and the junction
+* speed the smallest of maxAccel[i] / 2 / |d1[i]/L1 - d2[i]/L2|, computed
+* as maxAccel[i] * L1 * L2 / (2 * |d1[i] * L2 - d2[i] * L1|) without
+* division until the end. So no servo's velocity changes by more than its
+* acceleration in any frame.
+* The plan is the usual two passes over the buffer: backwards, so that
+* every move can slow down to the entry speed of the next (and the last to
+* rest), then forwards, so that none is entered faster than the move
+* before can speed up to. As in grbl, both passes stop at the last move
+* whose entry speed no later move can raise (one entered as fast as the
+* move before allows, or at its junction limit), so an add() to a long
+* buffer usually replans only its last few moves.
+* Everything is integer: lengths and speeds are 24.8 fixed point, and the
+* frame loop is the trapezoid of ServoController::setBlend(), with the
+* entry speed of the next move as the speed allowed on arrival, reached a
+* step early: the step that crosses a junction is no faster than that (or
+* ends exactly on it, and the next move starts at its entry speed), and the
+* rest of it carries on into the next move, so a path never stops at its
+* points.
+* A low supply lowers the top speed of the move being run rather than the
+* plan: the planned speeds are upper bounds, so running below them keeps
+* every limit, and a sudden drop in the scale still slows down at no more
+* than the move's acceleration. A critical supply stops the path where it
+* is, as in ServoController.
+*/
+
+#include "ServoPlanner.h"
+#include "ServoMath.h"
+
+#define SERVO_PLANNER_MASK   (SERVO_PLANNER_BLOCKS - 1)
+
+ServoPlanner::ServoPlanner(ServoGroup &group)
+{
+    this->group = &group;
+    this->axes = group.count();
+    for (int i = 0; i < MAX_SERVOS; i++)
+    {
+        Servo *servo = group.servo(i);
+        int position = servo ? servo->readMicroseconds() : 0;
+        this->maxSpeed[i] = SERVO_PLANNER_SPEED;
+        this->maxAccel[i] = SERVO_PLANNER_ACCEL;
+        this->end[i] = position;
+        this->position[i] = (int32_t)position << 8;
+    }
+}
+
+void ServoPlanner::setLimits(int index, int speed, int accel)
+{
+    if ((index < 0) || (index >= this->axes))
+        return;
+    this->maxSpeed[index] = (speed < 1) ? 1 : ((speed > 0x7FFF) ? 0x7FFF : speed);
+    this->maxAccel[index] = (accel < 1) ? 1 : ((accel > 0x7FFF) ? 0x7FFF : accel);
+}
+
+bool ServoPlanner::add(const int *values, int speed)
+{
+    if (this->count >= SERVO_PLANNER_BLOCKS)
+        return false;
+    Block *block = &this->blocks[(this->first + this->count) & SERVO_PLANNER_MASK];
+    for (int i = 0; i < this->axes; i++)
+    {
+        // as in Servo::write(), values below MIN_PULSE_WIDTH are degrees
+        Servo *servo = this->group->servo(i);
+        block->target[i] = servoTargetUs(values[i], servo->readMin(), servo->readMax());
+        block->delta[i] = block->target[i] - this->end[i];
+    }
+    block->length = servoMoveLength(block->delta, this->axes);
+    if (block->length == 0)
+        return true;                            // already there
+    servoMoveLimits(block->delta, this->axes, block->length, this->maxSpeed, this->maxAccel,
+                    (speed > 0) ? ((int64_t)speed << 8) : INT32_MAX, &block->maxSpeed, &block->accel);
+
+    // through the junction, no servo's velocity may change by more than half its acceleration
+    block->maxEntry = 0;                        // from rest if nothing is moving
+    if (this->count > 0)
+    {
+        Block *before = &this->blocks[(this->first + this->count - 1) & SERVO_PLANNER_MASK];
+        block->maxEntry = servoJunctionSpeed(before->delta, before->length, block->delta, block->length, this->axes,
+                                             this->maxAccel,
+                                             (block->maxSpeed < before->maxSpeed) ? block->maxSpeed : before->maxSpeed);
+    }
+    block->entry = 0;
+
+    for (int i = 0; i < this->axes; i++)
+        this->end[i] = block->target[i];
+    this->count++;
+    this->replan();
+    return true;
+}
+
+void ServoPlanner::replan()
+{
+    // backwards: each move must be able to slow down to the next, the last to rest
+    int32_t next = 0;
+    for (int k = this->count - 1; k > this->planned; k--)
+    {
+        Block *block = &this->blocks[(this->first + k) & SERVO_PLANNER_MASK];
+        int32_t reach = servoReachSpeed(next, block->accel, block->length);
+        block->entry = (reach < block->maxEntry) ? reach : block->maxEntry;
+        next = block->entry;
+    }
+    // forwards: no move is entered faster than the one before can speed up to
+    for (int k = this->planned + 1; k < this->count; k++)
+    {
+        Block *before = &this->blocks[(this->first + k - 1) & SERVO_PLANNER_MASK];
+        Block *block = &this->blocks[(this->first + k) & SERVO_PLANNER_MASK];
+        int32_t reach = servoReachSpeed(before->entry, before->accel, before->length);
+        // limited by the move before, or at its own limit: later moves cannot raise it
+        if (block->entry >= reach)
+        {
+            block->entry = reach;
+            this->planned = k;
+        }
+        else if (block->entry == block->maxEntry)
+            this->planned = k;
+    }
+}
+
+int ServoPlanner::space()
+{
+    return (SERVO_PLANNER_BLOCKS - this->count);
+}
+
+bool ServoPlanner::busy()
+{
+    return (this->count > 0);
+}
+
+void ServoPlanner::clear()
+{
+    this->count = 0;
+    this->planned = 0;
+    this->distance = 0;
+    this->speed = 0;
+    for (int i = 0; i < this->axes; i++)
+        this->end[i] = (this->position[i] + 128) >> 8;
+}
+
+void ServoPlanner::setSupply(ServoSupply *supply)
+{
+    this->supply = supply;
+}
+
+void ServoPlanner::update()
+{
+    int scale = this->supply ? this->supply->readScale() : SERVO_SUPPLY_SCALE_ONE;
+    if (scale <= 0)
+        this->speed = 0;                        // a critical supply holds the path where it is
+    else if (this->count > 0)
+    {
+        Block *block = &this->blocks[this->first];
+        int32_t arrival = (this->count > 1) ? this->blocks[(this->first + 1) & SERVO_PLANNER_MASK].entry : 0;
+        int32_t top = block->maxSpeed;
+        if (scale < SERVO_SUPPLY_SCALE_ONE)
+        {
+            // a low supply slows the path, no faster than the move may slow down
+            top = (int32_t)(((int64_t)top * scale) >> 8);
+            if (top < this->speed - block->accel)
+                top = this->speed - block->accel;
+        }
+        int32_t step = this->speed + block->accel;
+        if (step > top)
+            step = top;
+        // a move that began exactly at its junction starts at no more than its entry speed
+        if ((this->distance == 0) && (step > block->entry) && (this->speed > block->entry))
+            step = block->entry;
+        // slow down to the arrival speed a step before the junction, and cross it no faster
+        int32_t remaining = block->length - this->distance;
+        int32_t braking = servoReachSpeed(arrival, block->accel, (remaining > arrival) ? remaining - arrival : 0);
+        if (step > braking)
+            step = braking;
+        if ((step > remaining) && (step > arrival))
+            step = (remaining > arrival) ? remaining : arrival;     // else stop at the junction
+        if (step < 1)
+            step = 1;
+        this->speed = step;
+        this->distance += step;
+        // the rest of the step goes on into the next move
+        while ((this->count > 0) && (this->distance >= block->length))
+        {
+            this->distance -= block->length;
+            this->first = (this->first + 1) & SERVO_PLANNER_MASK;
+            this->count--;
+            if (this->planned > 0)
+                this->planned--;
+            if (this->count == 0)
+            {
+                for (int i = 0; i < this->axes; i++)
+                    this->position[i] = (int32_t)block->target[i] << 8;
+                this->distance = 0;
+                this->speed = 0;
+            }
+            else
+                block = &this->blocks[this->first];
+        }
+        if (this->count > 0)
+        {
+            int64_t fraction = ((int64_t)this->distance << 24) / block->length;
+            for (int i = 0; i < this->axes; i++)
+                this->position[i] = ((int32_t)(block->target[i] - block->delta[i]) << 8) +
+                                    (int32_t)((block->delta[i] * fraction) >> 16);
+        }
+        for (int i = 0; i < this->axes; i++)
+            this->group->stageMicroseconds(i, (this->position[i] + 128) >> 8);
+    }
+    this->group->commit();
+    this->frame++;
+}
+
+int ServoPlanner::readPosition(int index)
+{
+    if ((index < 0) || (index >= this->axes))
+        return 0;
+    return ((this->position[index] + 128) >> 8);
+}
+
+int ServoPlanner::readSpeed()
+{
+    return ((this->speed + 128) >> 8);
+}
+
+uint32_t ServoPlanner::readFrame()
+{
+    return (this->frame);
+}
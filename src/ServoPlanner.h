@@ -0,0 +1,120 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoPlanner.h - Lookahead planner for continuous multi-servo paths
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A ServoPlanner drives every servo of a ServoGroup along a path of
+  straight moves (in pulse width space, one coordinate per servo), the way
+  a CNC controller drives its axes: without stopping at the points between
+  moves, and without any servo going faster or accelerating harder than
+  its limits allow.
+
+  Moves are buffered (up to SERVO_PLANNER_BLOCKS), and every time one is
+  added the planner works out the speed through each junction between
+  buffered moves: at most the speed at which no servo's velocity changes
+  by more than half its acceleration in a frame as the path turns (the
+  other half is left for speeding up and slowing down), and low enough to
+  stop at the end of the last buffered move. update(), once per
+  frame, then advances along the path (speeding up and slowing down at the
+  limits to meet those junction speeds), stages every servo and commits
+  the group. A program feeds a long path by adding moves whenever
+  space() allows.
+
+  Speeds are in microseconds per frame and accelerations in microseconds
+  per frame per frame, for each servo.
+
+  The class methods are:
+
+    ServoPlanner(group) - Creates a planner for the servos of group; call
+        after they have been added and attached.
+    void setLimits(index, speed, accel) - Sets the limits of one servo
+        (SERVO_PLANNER_SPEED and SERVO_PLANNER_ACCEL by default).
+    bool add(values, speed) - Adds a move to values (one per servo, as in
+        Servo::write(); below 500 is degrees), at most speed along the path
+        (0 for the servos' limits only). Returns false if the buffer is
+        full.
+    int space() - Number of moves that can be added.
+    bool busy() - True while the servos are moving along the path.
+    void clear() - Stops where the servos are and drops the buffered moves.
+    void setSupply(supply) - Scales the speed along the path by the supply
+        voltage, and holds the servos where they are while it is critical
+        (see ServoSupply.h; 0 to stop).
+    void update() - Advances along the path by one frame and commits the
+        group. Call this once per frame.
+    int readPosition(index) - Commanded position in microseconds.
+    int readSpeed() - Speed along the path in the last frame, microseconds
+        per frame.
+    uint32_t readFrame() - Number of update() calls so far.
+ */
+
+#ifndef ServoPlanner_h
+#define ServoPlanner_h
+
+#include <stdint.h>
+#include "ServoGroup.h"
+#include "ServoSupply.h"
+
+#define SERVO_PLANNER_BLOCKS   32     // moves buffered for lookahead; a power of 2
+#define SERVO_PLANNER_SPEED    20     // default limit, microseconds per frame
+#define SERVO_PLANNER_ACCEL     2     // default limit, microseconds per frame per frame
+
+class ServoPlanner
+{
+public:
+  ServoPlanner(ServoGroup &group);
+  void setLimits(int index, int speed, int accel);
+  bool add(const int *values, int speed = 0);
+  int space();
+  bool busy();
+  void clear();
+  void setSupply(ServoSupply *supply);
+  void update();
+  int readPosition(int index);
+  int readSpeed();
+  uint32_t readFrame();
+
+  private:
+   struct Block
+   {
+     int16_t target[MAX_SERVOS];      // microseconds
+     int16_t delta[MAX_SERVOS];       // from the end of the block before
+     int32_t length;                  // euclidean, microseconds 24.8 fixed point
+     int32_t maxSpeed;                // along the path, microseconds per frame 24.8
+     int32_t accel;                   // along the path, 24.8
+     int32_t maxEntry;                // the junction limit with the block before
+     int32_t entry;                   // planned speed at its start
+   };
+   void replan();
+   ServoGroup *group;
+   ServoSupply *supply = 0;
+   int axes;
+   int16_t maxSpeed[MAX_SERVOS];
+   int16_t maxAccel[MAX_SERVOS];
+   int16_t end[MAX_SERVOS];           // target of the last block added
+   int32_t position[MAX_SERVOS];      // commanded, 24.8
+   Block blocks[SERVO_PLANNER_BLOCKS];
+   int first = 0;                     // the block being run
+   int count = 0;
+   int planned = 0;                   // moves up to this one (from first) are planned for good
+   int32_t distance = 0;              // along the block being run, 24.8
+   int32_t speed = 0;                 // step of the last frame, 24.8
+   uint32_t frame = 0;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The spacing is measured from the time a servo was actually attached, not
+* from when it was due, so a loop() that falls behind never makes two
+* servos start closer together than the spacing (the sequence just takes
+* longer). Elapsed time is the unsigned difference of micros() values,
+* which is correct across the micros() rollover. A step whose attach()
+* fails sends no pulses and draws no stall current, so it does not restart
+* the spacing; the next servo is due as soon as it would have been.
+*/
+
+#include "ServoPowerSequence.h"
+#include "Arduino.h"
+
+ServoPowerSequence::ServoPowerSequence()
+{
+}
+
+int ServoPowerSequence::add(Servo &servo, int pin, int min, int max, int target, int softStartFrames)
+{
+    if (this->numSteps >= MAX_SERVOS)
+        return -1;
+    Step *step = &this->steps[this->numSteps];
+    step->servo = &servo;
+    step->pin = pin;
+    step->min = min;
+    step->max = max;
+    step->target = target;
+    step->softStartFrames = softStartFrames;
+    return (this->numSteps++);
+}
+
+int ServoPowerSequence::count()
+{
+    return (this->numSteps);
+}
+
+void ServoPowerSequence::setSpacing(uint32_t usec)
+{
+    this->spacingUsec = usec;
+}
+
+void ServoPowerSequence::begin()
+{
+    this->begin(micros());
+}
+
+void ServoPowerSequence::begin(uint32_t nowUsec)
+{
+    this->next = 0;
+    this->attachedCount = 0;
+    this->failedCount = 0;
+    // the first servo is due at once
+    this->lastUsec = nowUsec - this->spacingUsec;
+}
+
+bool ServoPowerSequence::update()
+{
+    return (this->update(micros()));
+}
+
+bool ServoPowerSequence::update(uint32_t nowUsec)
+{
+    if ((this->next < 0) || (this->next >= this->numSteps))
+        return (this->next < 0);   // not begun yet, or finished
+    if ((uint32_t)(nowUsec - this->lastUsec) < this->spacingUsec)
+        return true;
+    Step *step = &this->steps[this->next++];
+    step->servo->setSoftStart(step->softStartFrames);
+    if (step->servo->attach(step->pin, step->min, step->max) == 0)
+    {
+        this->failedCount++;            // no channel: skip the step
+        return (this->next < this->numSteps);
+    }
+    this->attachedCount++;
+    if (step->target >= 0)
+        step->servo->write(step->target);
+    this->lastUsec = nowUsec;
+    return (this->next < this->numSteps);
+}
+
+int ServoPowerSequence::readAttached()
+{
+    return (this->attachedCount);
+}
+
+int ServoPowerSequence::readFailed()
+{
+    return (this->failedCount);
+}
+
+bool ServoPowerSequence::done()
+{
+    return ((this->next >= 0) && (this->next >= this->numSteps));
+}
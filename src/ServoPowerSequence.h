@@ -0,0 +1,96 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoPowerSequence.h - Staggered power-on of a set of ESP32 servos
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Every servo draws its stall current when it first gets a pulse, so
+  attaching a whole rig in setup() can pull the supply down far enough to
+  reset the board. A ServoPowerSequence attaches up to MAX_SERVOS servos one
+  at a time, in the order they were added, at least setSpacing()
+  microseconds apart, and writes each one's start position as it goes.
+  begin() returns at once; update() is called from loop() and attaches the
+  next servo when it is due. A servo can also be soft started (see
+  Servo::setSoftStart()), in which case Servo::updateAll() must be called
+  once per refresh period as well.
+
+  The class methods are:
+
+    ServoPowerSequence() - Creates an empty sequence.
+    int add(servo, pin, min, max, target, softStartFrames) - Adds a step:
+        attach servo to pin with the given limits, then write target (in
+        degrees or microseconds, as Servo::write(); -1 writes nothing).
+        softStartFrames is passed to Servo::setSoftStart(). Returns the
+        step number, or -1 if the sequence is full.
+    int count() - Number of steps.
+    void setSpacing(usec) - Least time between two attaches (default
+        SERVO_POWER_SPACING_USEC).
+    void begin() / begin(nowUsec) - Starts the sequence; the first servo is
+        attached by the next update().
+    bool update() / update(nowUsec) - Attaches the next servo if it is due
+        (never more than one per call); returns true while steps remain.
+    int readAttached() - Number of servos attached so far. A step whose
+        attach() fails (no channel free) is skipped and not counted.
+    int readFailed() - Number of steps skipped because attach() failed.
+    bool done() - True once every step has been carried out.
+ */
+
+#ifndef ServoPowerSequence_h
+#define ServoPowerSequence_h
+
+#include <stdint.h>
+#include "ESP32_Servo.h"
+
+#define SERVO_POWER_SPACING_USEC   100000    // 100 ms between attaches
+
+class ServoPowerSequence
+{
+public:
+  ServoPowerSequence();
+  int add(Servo &servo, int pin, int min = DEFAULT_uS_LOW, int max = DEFAULT_uS_HIGH,
+          int target = -1, int softStartFrames = 0);
+  int count();
+  void setSpacing(uint32_t usec);
+  void begin();
+  void begin(uint32_t nowUsec);
+  bool update();
+  bool update(uint32_t nowUsec);             // true while steps remain
+  int readAttached();
+  int readFailed();
+  bool done();
+
+  private:
+   struct Step
+   {
+     Servo *servo;
+     int8_t pin;
+     int16_t min;
+     int16_t max;
+     int16_t target;          // -1: no initial write
+     int16_t softStartFrames;
+   };
+   Step steps[MAX_SERVOS];
+   int numSteps = 0;
+   int next = -1;                            // next step to carry out; -1 before begin()
+   int attachedCount = 0;                    // steps whose attach() succeeded
+   int failedCount = 0;                      // steps skipped because attach() failed
+   uint32_t spacingUsec = SERVO_POWER_SPACING_USEC;
+   uint32_t lastUsec = 0;                    // when the last servo was attached
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* Time is kept as an integer phase, so there is no accumulated rounding
+* drift however long the stream: one input interval is outHz phase units
+* and one output interval is inHz units. Output frames are emitted while
+* the phase is inside the current input interval.
+*
+* A pulse of t input ticks lasts t * (1/inHz) / 2**inWidth seconds, so in
+* output ticks it is t * outHz * 2**outWidth / (inHz * 2**inWidth). The
+* powers of two are cancelled first so the product fits in 64 bits.
+*/
+
+#include "ServoResampler.h"
+#include "ServoMotion.h"
+
+ServoResampler::ServoResampler()
+{
+    for (int i = 0; i < MAX_SERVOS; i++)
+        this->previous[i] = 0;
+}
+
+bool ServoResampler::begin(int channels, int inHz, int inWidth, int outHz, int outWidth)
+{
+    if ((channels <= 0) || (channels > MAX_SERVOS) || (inHz <= 0) || (outHz <= 0))
+        return false;
+    if ((inWidth < 1) || (inWidth > 20) || (outWidth < 1) || (outWidth > 20))
+        return false;
+    this->channels = channels;
+    this->inHz = inHz;
+    this->outHz = outHz;
+    this->phase = 0;
+    this->havePrevious = false;
+    if (outWidth >= inWidth)
+    {
+        this->scaleNum = (int64_t)outHz << (outWidth - inWidth);
+        this->scaleDen = (int64_t)inHz << 16;
+    }
+    else
+    {
+        this->scaleNum = outHz;
+        this->scaleDen = (int64_t)inHz << (16 + inWidth - outWidth);
+    }
+    return true;
+}
+
+int ServoResampler::maxOutputFrames()
+{
+    return ((this->outHz + this->inHz - 1) / this->inHz);
+}
+
+uint32_t ServoResampler::rescale(int64_t ticks16)
+{
+    return (uint32_t)((ticks16 * this->scaleNum + (this->scaleDen / 2)) / this->scaleDen);
+}
+
+int ServoResampler::push(const uint32_t *in, uint32_t *out, int maxOut)
+{
+    if (maxOut < this->maxOutputFrames())
+        return -1;
+    int written = 0;
+    if (this->havePrevious)
+    {
+        while (this->phase < this->outHz)
+        {
+            int64_t frac = ((int64_t)this->phase << 16) / this->outHz;
+            for (int c = 0; c < this->channels; c++)
+            {
+                int64_t a = this->previous[c];
+                int64_t b = in[c];
+                *out++ = this->rescale((a << 16) + (b - a) * frac);
+            }
+            written++;
+            this->phase += this->inHz;
+        }
+        this->phase -= this->outHz;
+    }
+    for (int c = 0; c < this->channels; c++)
+        this->previous[c] = in[c];
+    this->havePrevious = true;
+    return written;
+}
+
+int ServoResampler::flush(uint32_t *out, int maxOut)
+{
+    // only an output frame exactly on the last input frame is left
+    if (!this->havePrevious || (this->phase != 0) || (maxOut < 1))
+        return 0;
+    for (int c = 0; c < this->channels; c++)
+        out[c] = this->rescale((int64_t)this->previous[c] << 16);
+    this->phase = this->inHz;     // it has been written; don't write it twice
+    return 1;
+}
+
+int servoResampleMotion(const uint32_t *in, uint32_t *out, int maxWords, int outHz, int outWidth)
+{
+    const ServoMotionHeader *header = (const ServoMotionHeader *)in;
+    if ((header->magic != SERVO_MOTION_MAGIC) || (header->version != SERVO_MOTION_VERSION))
+        return -1;
+    ServoResampler resampler;
+    if (!resampler.begin(header->channels, header->refreshHz, header->timerWidth, outHz, outWidth))
+        return -1;
+    int channels = header->channels;
+    int frameCount = 0;
+    if (header->frameCount > 0)
+        frameCount = (int)(((int64_t)(header->frameCount - 1) * outHz) / header->refreshHz) + 1;
+    int words = servoMotionWords(frameCount, channels);
+    if (words > maxWords)
+        return -1;
+
+    ServoMotionHeader *outHeader = (ServoMotionHeader *)out;
+    *outHeader = *header;
+    outHeader->timerWidth = outWidth;
+    outHeader->refreshHz = outHz;
+    outHeader->frameCount = frameCount;
+
+    const uint32_t *src = in + SERVO_MOTION_HEADER_WORDS;
+    uint32_t *dst = out + SERVO_MOTION_HEADER_WORDS;
+    int room = frameCount;
+    for (uint32_t f = 0; f < header->frameCount; f++)
+    {
+        int n = resampler.push(src, dst, resampler.maxOutputFrames());
+        src += channels;
+        dst += n * channels;
+        room -= n;
+    }
+    room -= resampler.flush(dst, room);
+    return (room == 0) ? words : -1;
+}
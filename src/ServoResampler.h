@@ -0,0 +1,76 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoResampler.h - Frame rate and timer width conversion of tick streams
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Motion recorded as ticks for one refresh rate and timer width (say 50 Hz,
+  16 bits) does not play correctly with another (200 Hz, or 20 bits after
+  setTimerWidth()): both the frame timing and the tick scale differ.
+  ServoResampler converts a stream frame by frame, linearly interpolating
+  between input frames in 16.16 fixed point and rescaling ticks exactly
+  (rational arithmetic, rounded to nearest). Memory use is bounded: only
+  the previous input frame is kept.
+
+  The class methods are:
+
+    ServoResampler() - Creates a resampler; call begin() before use.
+    bool begin(channels, inHz, inWidth, outHz, outWidth) - Sets up the
+        conversion; returns false if a parameter is invalid.
+    int maxOutputFrames() - The most output frames one push() can produce.
+    int push(in, out, maxOut) - Feeds one input frame (channels ticks);
+        writes the output frames that fall before it into out and returns
+        how many, or -1 if maxOut is smaller than maxOutputFrames().
+    int flush(out, maxOut) - Writes the output frame that lands exactly on
+        the last input frame, if any; returns the number of frames written.
+
+    int servoResampleMotion(in, out, maxWords, outHz, outWidth) - Converts
+        a whole baked motion (see ServoMotion.h); returns the number of
+        words written or -1 if out is too small or in is not a motion.
+ */
+
+#ifndef ServoResampler_h
+#define ServoResampler_h
+
+#include <stdint.h>
+#include "ESP32_Servo.h"
+
+class ServoResampler
+{
+public:
+  ServoResampler();
+  bool begin(int channels, int inHz, int inWidth, int outHz, int outWidth);
+  int maxOutputFrames();
+  int push(const uint32_t *in, uint32_t *out, int maxOut);
+  int flush(uint32_t *out, int maxOut);
+
+  private:
+   uint32_t rescale(int64_t ticks16);   // 16.16 input ticks -> output ticks
+   uint32_t previous[MAX_SERVOS];       // last input frame
+   bool havePrevious = false;
+   int channels = 0;
+   int inHz = 0;
+   int outHz = 0;
+   int phase = 0;                       // next output time after previous, in 1/(inHz*outHz) s
+   int64_t scaleNum = 1;                // output ticks = input ticks * scaleNum / scaleDen
+   int64_t scaleDen = 1;
+};
+
+int servoResampleMotion(const uint32_t *in, uint32_t *out, int maxWords, int outHz, int outWidth);
+
+#endif
@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The interpreter is a plain switch over fixed size instructions. All state
+* (registers, program counter, wait counter) lives in the object, so nothing
+* is allocated and a frame costs only the instructions actually executed.
+* A script that runs SERVO_SCRIPT_MAX_STEPS instructions without waiting is
+* assumed to be stuck in a loop and is stopped, so one bad script cannot
+* stall loop().
+*/
+
+#include "ServoScript.h"
+
+ServoScript::ServoScript(Servo **servos, int count)
+{
+    this->servos = servos;
+    this->servoCount = count;
+    this->restart();
+}
+
+void ServoScript::load(const uint8_t *code, int length)
+{
+    this->code = code;
+    this->insnCount = length / SERVO_SCRIPT_INSN_SIZE;
+    this->restart();
+}
+
+void ServoScript::restart()
+{
+    this->pc = 0;
+    this->waitFrames = 0;
+    this->groupMask = 0;
+    for (int i = 0; i < SERVO_SCRIPT_REGISTERS; i++)
+        this->reg[i] = 0;
+    this->isRunning = (this->code != 0) && (this->insnCount > 0);
+}
+
+void ServoScript::setInputs(uint32_t bits)
+{
+    this->inputs = bits;
+}
+
+bool ServoScript::running()
+{
+    return (this->isRunning);
+}
+
+int ServoScript::readRegister(int n)
+{
+    if ((n < 0) || (n >= SERVO_SCRIPT_REGISTERS))
+        return 0;
+    return (this->reg[n]);
+}
+
+void ServoScript::writeChannel(int channel, int value)
+{
+    if ((channel >= 0) && (channel < this->servoCount) && (this->servos[channel] != 0))
+        this->servos[channel]->write(value);
+}
+
+int ServoScript::runFrame()
+{
+    if (!this->isRunning)
+        return 0;
+
+    // still waiting from a previous frame?
+    if (this->waitFrames > 0)
+    {
+        this->waitFrames--;
+        if (this->waitFrames > 0)
+            return 0;
+    }
+
+    int steps = 0;
+    while (steps < SERVO_SCRIPT_MAX_STEPS)
+    {
+        if ((this->pc < 0) || (this->pc >= this->insnCount))
+        {
+            // running off either end is the same as halt
+            this->isRunning = false;
+            return steps;
+        }
+        const uint8_t *insn = this->code + (this->pc * SERVO_SCRIPT_INSN_SIZE);
+        uint8_t op = insn[0];
+        uint8_t a = insn[1];
+        int16_t b = (int16_t)(insn[2] | (insn[3] << 8));
+        this->pc++;
+        steps++;
+
+        switch (op)
+        {
+            case SERVO_OP_SET:
+                this->reg[a & (SERVO_SCRIPT_REGISTERS-1)] = b;
+                break;
+            case SERVO_OP_ADD:
+                this->reg[a & (SERVO_SCRIPT_REGISTERS-1)] += b;
+                break;
+            case SERVO_OP_MOVE:
+                this->writeChannel(a, b);
+                break;
+            case SERVO_OP_MOVER:
+                this->writeChannel(a, this->reg[b & (SERVO_SCRIPT_REGISTERS-1)]);
+                break;
+            case SERVO_OP_GROUP:
+                this->groupMask = (uint16_t)b;
+                break;
+            case SERVO_OP_GMOVE:
+            case SERVO_OP_GMOVER:
+            {
+                int value = (op == SERVO_OP_GMOVE) ? b : this->reg[b & (SERVO_SCRIPT_REGISTERS-1)];
+                for (int i = 0; i < 16; i++)
+                {
+                    if (this->groupMask & (1 << i))
+                        this->writeChannel(i, value);
+                }
+                break;
+            }
+            case SERVO_OP_WAIT:
+            case SERVO_OP_WAITR:
+            {
+                int frames = (op == SERVO_OP_WAIT) ? b : this->reg[b & (SERVO_SCRIPT_REGISTERS-1)];
+                if (frames > 0)
+                {
+                    this->waitFrames = frames;
+                    return steps;
+                }
+                break;
+            }
+            case SERVO_OP_JMP:
+                this->pc = b;
+                break;
+            case SERVO_OP_DJNZ:
+                if (--this->reg[a & (SERVO_SCRIPT_REGISTERS-1)] != 0)
+                    this->pc = b;
+                break;
+            case SERVO_OP_JIN:
+                if ((this->inputs >> (a & 31)) & 1)
+                    this->pc = b;
+                break;
+            case SERVO_OP_JNIN:
+                if (!((this->inputs >> (a & 31)) & 1))
+                    this->pc = b;
+                break;
+            case SERVO_OP_HALT:
+            default:           // unknown opcodes halt the script
+                this->isRunning = false;
+                return steps;
+        }
+    }
+    // too many instructions without a wait; stop the script
+    this->isRunning = false;
+    return steps;
+}
@@ -0,0 +1,120 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoScript.h - Compact bytecode interpreter for servo motion scripts
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A motion script is assembled (offline, or once in setup()) from text into
+  a compact bytecode, and then interpreted once per frame from loop(). The
+  interpreter never allocates memory and never parses strings at run time.
+
+  Every instruction is SERVO_SCRIPT_INSN_SIZE (4) bytes: opcode, an 8 bit
+  operand A, and a signed 16 bit operand B (little endian). There are
+  SERVO_SCRIPT_REGISTERS (8) signed 16 bit registers, r0 - r7. Jump targets
+  are instruction indices, not byte offsets.
+
+  Assembler syntax (one instruction per line, ';' starts a comment,
+  "name:" defines a label):
+
+    set   rN value        - rN = value
+    add   rN value        - rN = rN + value
+    move  ch value|rN     - servo[ch].write(value)
+    group mask            - select the servos used by gmove (bit n = servo n)
+    gmove value|rN        - write value to every servo in the group mask
+    wait  frames|rN       - stop for this many frames (wait 1 = next frame)
+    jmp   label           - jump to label
+    djnz  rN label        - rN = rN - 1; jump to label if rN is not zero
+    jin   bit label       - jump to label if input bit is set
+    jnin  bit label       - jump to label if input bit is clear
+    halt                  - stop the script
+
+  The class methods are:
+
+    ServoScript(servos, count) - Creates an interpreter driving the given
+        array of Servo pointers; script channel n is servos[n].
+    void load(code, length) - Loads assembled bytecode and restarts it. The
+        code is not copied, so it may live in flash.
+    void restart() - Restarts the loaded script and clears the registers.
+    void setInputs(bits) - Sets the input bits tested by jin/jnin.
+    int runFrame() - Runs the script until it waits or halts; returns the
+        number of instructions executed. Call this once per frame.
+    bool running() - Returns true until the script halts or faults.
+    int readRegister(n) - Gets the value of register n.
+
+    int servoScriptAssemble(source, out, maxBytes, errorLine) - Assembles
+        source text into out; returns the number of bytes written, or -1 on
+        error (with the offending line number stored in errorLine). This
+        function does not depend on Arduino, so it can be built on a host.
+ */
+
+#ifndef ServoScript_h
+#define ServoScript_h
+
+#include <stdint.h>
+#include "ESP32_Servo.h"
+
+#define SERVO_SCRIPT_INSN_SIZE       4     // bytes per instruction
+#define SERVO_SCRIPT_REGISTERS       8     // r0 - r7
+#define SERVO_SCRIPT_MAX_STEPS     256     // instructions per frame before the script is faulted
+#define SERVO_SCRIPT_MAX_LABELS     32     // labels per source file (assembler)
+#define SERVO_SCRIPT_LABEL_LENGTH   16     // including the terminating zero
+
+// opcodes
+#define SERVO_OP_HALT      0
+#define SERVO_OP_SET       1
+#define SERVO_OP_ADD       2
+#define SERVO_OP_MOVE      3     // A = channel, B = value
+#define SERVO_OP_MOVER     4     // A = channel, B = register
+#define SERVO_OP_GROUP     5     // B = channel mask
+#define SERVO_OP_GMOVE     6     // B = value
+#define SERVO_OP_GMOVER    7     // B = register
+#define SERVO_OP_WAIT      8     // B = frames
+#define SERVO_OP_WAITR     9     // B = register
+#define SERVO_OP_JMP      10     // B = target
+#define SERVO_OP_DJNZ     11     // A = register, B = target
+#define SERVO_OP_JIN      12     // A = input bit, B = target
+#define SERVO_OP_JNIN     13     // A = input bit, B = target
+
+class ServoScript
+{
+public:
+  ServoScript(Servo **servos, int count);
+  void load(const uint8_t *code, int length);  // code is used in place, not copied
+  void restart();
+  void setInputs(uint32_t bits);               // bits tested by jin/jnin
+  int runFrame();                              // returns the number of instructions executed
+  bool running();                              // false once halted or faulted
+  int readRegister(int n);
+
+  private:
+   Servo **servos;                             // script channel n drives servos[n]
+   int servoCount;
+   const uint8_t *code = 0;
+   int insnCount = 0;                          // program length in instructions
+   int pc = 0;                                 // next instruction index
+   int waitFrames = 0;                         // frames left before execution resumes
+   uint16_t groupMask = 0;
+   uint32_t inputs = 0;
+   bool isRunning = false;
+   int16_t reg[SERVO_SCRIPT_REGISTERS];
+   void writeChannel(int channel, int value);
+};
+
+int servoScriptAssemble(const char *source, uint8_t *out, int maxBytes, int *errorLine);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* This is a two pass assembler: the first pass records the instruction
+* index of every label, the second pass emits the bytecode. It uses only
+* the C library (no Arduino calls and no heap), so the same source can be
+* compiled into a host tool that converts show scripts ahead of time, or
+* called once from setup() on the ESP32.
+*/
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ServoScript.h"
+
+#define SERVO_SCRIPT_TOKEN_LENGTH 24
+#define SERVO_SCRIPT_MAX_TOKENS    3
+
+struct ServoScriptLabel
+{
+    char name[SERVO_SCRIPT_LABEL_LENGTH];
+    int index;
+};
+
+// split one source line into a label (if any) and up to three tokens;
+// returns the number of tokens, or -1 if a token is too long
+static int splitLine(const char *line, int length, char *label,
+                     char tokens[SERVO_SCRIPT_MAX_TOKENS][SERVO_SCRIPT_TOKEN_LENGTH])
+{
+    int count = 0;
+    int i = 0;
+    label[0] = 0;
+    while (i < length)
+    {
+        while ((i < length) && isspace((unsigned char)line[i]))
+            i++;
+        if ((i >= length) || (line[i] == ';'))
+            break;
+        int start = i;
+        while ((i < length) && !isspace((unsigned char)line[i]) && (line[i] != ';'))
+            i++;
+        int tokenLength = i - start;
+        if ((count == 0) && (label[0] == 0) && (line[i-1] == ':'))
+        {
+            // label definition
+            if (tokenLength - 1 >= SERVO_SCRIPT_LABEL_LENGTH)
+                return -1;
+            memcpy(label, line + start, tokenLength - 1);
+            label[tokenLength - 1] = 0;
+            continue;
+        }
+        if ((count >= SERVO_SCRIPT_MAX_TOKENS) || (tokenLength >= SERVO_SCRIPT_TOKEN_LENGTH))
+            return -1;
+        memcpy(tokens[count], line + start, tokenLength);
+        tokens[count][tokenLength] = 0;
+        count++;
+    }
+    return count;
+}
+
+// parse a number (decimal or 0x hex); returns false if the token is not a number
+static bool parseNumber(const char *token, long *value)
+{
+    char *end;
+    *value = strtol(token, &end, 0);
+    return ((end != token) && (*end == 0));
+}
+
+// parse a register name r0 - r7; returns -1 if the token is not a register
+static int parseRegister(const char *token)
+{
+    if (((token[0] == 'r') || (token[0] == 'R')) && (token[1] >= '0') &&
+        (token[1] < '0' + SERVO_SCRIPT_REGISTERS) && (token[2] == 0))
+        return (token[1] - '0');
+    return -1;
+}
+
+static int findLabel(const ServoScriptLabel *labels, int labelCount, const char *name)
+{
+    for (int i = 0; i < labelCount; i++)
+    {
+        if (strcmp(labels[i].name, name) == 0)
+            return labels[i].index;
+    }
+    return -1;
+}
+
+int servoScriptAssemble(const char *source, uint8_t *out, int maxBytes, int *errorLine)
+{
+    ServoScriptLabel labels[SERVO_SCRIPT_MAX_LABELS];
+    int labelCount = 0;
+    char label[SERVO_SCRIPT_LABEL_LENGTH];
+    char tokens[SERVO_SCRIPT_MAX_TOKENS][SERVO_SCRIPT_TOKEN_LENGTH];
+    int bytes = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const char *line = source;
+        int lineNumber = 0;
+        int index = 0;
+        while (*line)
+        {
+            const char *next = strchr(line, '\n');
+            int length = next ? (int)(next - line) : (int)strlen(line);
+            lineNumber++;
+            if (errorLine)
+                *errorLine = lineNumber;
+
+            int count = splitLine(line, length, label, tokens);
+            if (count < 0)
+                return -1;
+            if ((pass == 0) && (label[0] != 0))
+            {
+                if ((labelCount >= SERVO_SCRIPT_MAX_LABELS) || (findLabel(labels, labelCount, label) >= 0))
+                    return -1;
+                strcpy(labels[labelCount].name, label);
+                labels[labelCount].index = index;
+                labelCount++;
+            }
+            if (count > 0)
+            {
+                if (pass == 1)
+                {
+                    // encode the instruction
+                    const char *op = tokens[0];
+                    uint8_t opcode;
+                    long a = 0;
+                    long b = 0;
+                    int reg;
+                    int expected;
+                    if (strcmp(op, "halt") == 0)
+                    {
+                        opcode = SERVO_OP_HALT;
+                        expected = 1;
+                    }
+                    else if ((strcmp(op, "set") == 0) || (strcmp(op, "add") == 0))
+                    {
+                        opcode = (op[0] == 's') ? SERVO_OP_SET : SERVO_OP_ADD;
+                        expected = 3;
+                        if ((count != 3) || ((a = parseRegister(tokens[1])) < 0) || !parseNumber(tokens[2], &b))
+                            return -1;
+                    }
+                    else if (strcmp(op, "move") == 0)
+                    {
+                        expected = 3;
+                        if ((count != 3) || !parseNumber(tokens[1], &a) || (a < 0) || (a > 255))
+                            return -1;
+                        if ((reg = parseRegister(tokens[2])) >= 0)
+                        {
+                            opcode = SERVO_OP_MOVER;
+                            b = reg;
+                        }
+                        else if (parseNumber(tokens[2], &b))
+                            opcode = SERVO_OP_MOVE;
+                        else
+                            return -1;
+                    }
+                    else if ((strcmp(op, "gmove") == 0) || (strcmp(op, "wait") == 0))
+                    {
+                        bool gmove = (op[0] == 'g');
+                        expected = 2;
+                        if (count != 2)
+                            return -1;
+                        if ((reg = parseRegister(tokens[1])) >= 0)
+                        {
+                            opcode = gmove ? SERVO_OP_GMOVER : SERVO_OP_WAITR;
+                            b = reg;
+                        }
+                        else if (parseNumber(tokens[1], &b))
+                            opcode = gmove ? SERVO_OP_GMOVE : SERVO_OP_WAIT;
+                        else
+                            return -1;
+                    }
+                    else if (strcmp(op, "group") == 0)
+                    {
+                        opcode = SERVO_OP_GROUP;
+                        expected = 2;
+                        if ((count != 2) || !parseNumber(tokens[1], &b) || (b < 0) || (b > 0xFFFF))
+                            return -1;
+                        b = (int16_t)(uint16_t)b;
+                    }
+                    else if (strcmp(op, "jmp") == 0)
+                    {
+                        opcode = SERVO_OP_JMP;
+                        expected = 2;
+                        if ((count != 2) || ((b = findLabel(labels, labelCount, tokens[1])) < 0))
+                            return -1;
+                    }
+                    else if ((strcmp(op, "djnz") == 0) || (strcmp(op, "jin") == 0) || (strcmp(op, "jnin") == 0))
+                    {
+                        expected = 3;
+                        if (count != 3)
+                            return -1;
+                        if (op[0] == 'd')
+                        {
+                            opcode = SERVO_OP_DJNZ;
+                            a = parseRegister(tokens[1]);
+                        }
+                        else
+                        {
+                            opcode = (op[1] == 'i') ? SERVO_OP_JIN : SERVO_OP_JNIN;
+                            if (!parseNumber(tokens[1], &a) || (a > 31))
+                                a = -1;
+                        }
+                        if ((a < 0) || ((b = findLabel(labels, labelCount, tokens[2])) < 0))
+                            return -1;
+                    }
+                    else
+                    {
+                        return -1;     // unknown mnemonic
+                    }
+                    if ((count != expected) || (b < -32768) || (b > 32767))
+                        return -1;
+                    if (bytes + SERVO_SCRIPT_INSN_SIZE > maxBytes)
+                        return -1;
+                    out[bytes++] = opcode;
+                    out[bytes++] = (uint8_t)a;
+                    out[bytes++] = (uint8_t)(b & 0xFF);
+                    out[bytes++] = (uint8_t)((b >> 8) & 0xFF);
+                }
+                index++;
+            }
+            line = next ? next + 1 : line + length;
+        }
+    }
+    if (errorLine)
+        *errorLine = 0;
+    return bytes;
+}
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* Tracks are validated once, in addTrack(), against the group (channel map
+* in range, timer widths match), so step() is only index arithmetic and
+* ServoGroup::stageTicks() calls, followed by a single commit().
+*/
+
+#include "ServoSequencer.h"
+
+ServoSequencer::ServoSequencer(ServoGroup &group)
+{
+    this->group = &group;
+}
+
+int ServoSequencer::addTrack(const uint32_t *motion, const uint8_t *channelMap, int offset, bool loop)
+{
+    const ServoMotionHeader *header = (const ServoMotionHeader *)motion;
+    if (this->numTracks >= SERVO_SEQUENCER_MAX_TRACKS)
+        return -1;
+    if ((header->magic != SERVO_MOTION_MAGIC) || (header->version != SERVO_MOTION_VERSION))
+        return -1;
+    if ((header->channels == 0) || (header->channels > MAX_SERVOS) || (header->frameCount == 0) ||
+        (header->refreshHz != REFRESH_CPS))
+        return -1;
+
+    Track *track = &this->tracks[this->numTracks];
+    for (int c = 0; c < header->channels; c++)
+    {
+        uint8_t target = channelMap[c];
+        if (target != SERVO_TRACK_UNMAPPED)
+        {
+            Servo *servo = this->group->servo(target);
+            if ((servo == 0) || (servo->readTimerWidth() != header->timerWidth))
+                return -1;
+        }
+        track->map[c] = target;
+    }
+    track->frames = motion + SERVO_MOTION_HEADER_WORDS;
+    track->channels = header->channels;
+    track->frameCount = header->frameCount;
+    track->offset = offset;
+    track->loop = loop;
+    track->enabled = true;
+    return (this->numTracks++);
+}
+
+void ServoSequencer::setEnabled(int track, bool enabled)
+{
+    if ((track >= 0) && (track < this->numTracks))
+        this->tracks[track].enabled = enabled;
+}
+
+void ServoSequencer::setLoop(int track, bool loop)
+{
+    if ((track >= 0) && (track < this->numTracks))
+        this->tracks[track].loop = loop;
+}
+
+void ServoSequencer::setOffset(int track, int offset)
+{
+    if ((track >= 0) && (track < this->numTracks))
+        this->tracks[track].offset = offset;
+}
+
+int ServoSequencer::trackCount()
+{
+    return (this->numTracks);
+}
+
+void ServoSequencer::start()
+{
+    this->frame = 0;
+}
+
+void ServoSequencer::step()
+{
+    for (int t = 0; t < this->numTracks; t++)
+    {
+        Track *track = &this->tracks[t];
+        int local = this->frame - track->offset;
+        if (!track->enabled || (local < 0))
+            continue;      // muted, or not started yet
+        if (local >= track->frameCount)
+            local = track->loop ? (local % track->frameCount) : (track->frameCount - 1);
+        const uint32_t *values = track->frames + (local * track->channels);
+        for (int c = 0; c < track->channels; c++)
+        {
+            if (track->map[c] != SERVO_TRACK_UNMAPPED)
+                this->group->stageTicks(track->map[c], values[c]);
+        }
+    }
+    this->group->commit();
+    this->frame++;
+}
+
+int ServoSequencer::readFrame()
+{
+    return (this->frame);
+}
@@ -0,0 +1,86 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoSequencer.h - Multi-track playback of baked motions onto a ServoGroup
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  A show is often made of independent tracks (eyes, mouth, neck) with
+  different lengths. Each track is a baked motion (see ServoMotion.h) with
+  its own channel map onto the servos of a ServoGroup, a start offset in
+  frames, and either loops or holds its last frame when it ends. step()
+  stages every track's values for the current frame and commits the group
+  once. If two tracks map onto the same servo, the later track wins.
+
+  The class methods are:
+
+    ServoSequencer(group) - Creates a sequencer driving group.
+    int addTrack(motion, channelMap, offset, loop) - Adds a track; track
+        channel n drives group servo channelMap[n] (SERVO_TRACK_UNMAPPED to
+        skip it). The track starts offset frames after start() (a negative
+        offset starts it part way through). Returns the track index, or -1
+        if the sequencer is full or the motion does not match the group.
+    void setEnabled(track, enabled) - Mutes or unmutes a track.
+    void setLoop(track, loop) - Loops a track, or holds its last frame.
+    void setOffset(track, offset) - Moves a track's start.
+    int trackCount() - Number of tracks.
+    void start() - Rewinds to frame 0.
+    void step() - Plays the current frame of every track in one commit,
+        then moves to the next frame. Call once per frame.
+    int readFrame() - The next frame step() will play.
+ */
+
+#ifndef ServoSequencer_h
+#define ServoSequencer_h
+
+#include <stdint.h>
+#include "ServoMotion.h"
+
+#define SERVO_SEQUENCER_MAX_TRACKS  16
+#define SERVO_TRACK_UNMAPPED      0xFF     // channel map entry for an unused track channel
+
+class ServoSequencer
+{
+public:
+  ServoSequencer(ServoGroup &group);
+  int addTrack(const uint32_t *motion, const uint8_t *channelMap, int offset = 0, bool loop = true);
+  void setEnabled(int track, bool enabled);
+  void setLoop(int track, bool loop);
+  void setOffset(int track, int offset);
+  int trackCount();
+  void start();
+  void step();
+  int readFrame();
+
+  private:
+   struct Track
+   {
+     const uint32_t *frames;               // first frame, just past the header
+     int channels;
+     int frameCount;
+     int offset;
+     bool loop;
+     bool enabled;
+     uint8_t map[MAX_SERVOS];              // track channel -> group index
+   };
+   ServoGroup *group;
+   Track tracks[SERVO_SEQUENCER_MAX_TRACKS];
+   int numTracks = 0;
+   int frame = 0;
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* The correction is proportional: the clock runs (error / 2) ppm fast or
+* slow, so an error is halved roughly every 1.4 seconds. A constant crystal
+* offset of d ppm between us and the timecode master leaves a steady error
+* of about 2d microseconds, far below one frame, so no integral term is
+* needed. Elapsed time is taken as the unsigned difference of micros()
+* values, which is correct across the 71 minute micros() rollover.
+*/
+
+#include "ServoShowClock.h"
+#include "Arduino.h"
+
+void ServoLocalTimecode::start()
+{
+    this->lastUsec = micros();
+    this->elapsed = 0;
+}
+
+bool ServoLocalTimecode::readTimecode(int64_t *showUsec)
+{
+    uint32_t now = micros();
+    this->elapsed += (uint32_t)(now - this->lastUsec);
+    this->lastUsec = now;
+    *showUsec = this->elapsed;
+    return true;
+}
+
+ServoShowClock::ServoShowClock(ServoTimecodeSource &source, int frameUsec)
+{
+    this->source = &source;
+    this->frameUsec = (frameUsec > 0) ? frameUsec : REFRESH_USEC;
+}
+
+void ServoShowClock::begin()
+{
+    this->begin(micros());
+}
+
+void ServoShowClock::begin(uint32_t nowUsec)
+{
+    int64_t timecode;
+    this->pos = 0;
+    this->isLocked = false;
+    if (this->source->readTimecode(&timecode))
+    {
+        this->pos = timecode;
+        this->isLocked = true;
+    }
+    this->lastUsec = nowUsec;
+    this->remainder = 0;
+    this->filteredError = 0;
+    this->ratePpm = 0;
+    this->lastPlayed = -1;
+}
+
+void ServoShowClock::update()
+{
+    this->update(micros());
+}
+
+void ServoShowClock::update(uint32_t nowUsec)
+{
+    // free-run from the local clock, with the current rate correction
+    uint32_t elapsed = nowUsec - this->lastUsec;
+    this->lastUsec = nowUsec;
+    int64_t scaled = (int64_t)elapsed * this->ratePpm + this->remainder;
+    this->pos += elapsed + (scaled / 1000000);
+    this->remainder = (int32_t)(scaled % 1000000);
+
+    int64_t timecode;
+    if (!this->source->readTimecode(&timecode))
+    {
+        // dropout: keep running at the last rate
+        this->isLocked = false;
+        return;
+    }
+    int64_t error = timecode - this->pos;
+    if ((error > this->seekUsec) || (error < -this->seekUsec))
+    {
+        // a jump in the timecode; follow it at once
+        this->pos = timecode;
+        this->remainder = 0;
+        this->filteredError = 0;
+        this->ratePpm = 0;
+        this->isLocked = true;
+        return;
+    }
+    this->filteredError += ((int32_t)error - this->filteredError) >> SERVO_CLOCK_FILTER_SHIFT;
+    int rate = this->filteredError / 2;
+    if (rate > this->maxSlewPpm)
+        rate = this->maxSlewPpm;
+    else if (rate < -this->maxSlewPpm)
+        rate = -this->maxSlewPpm;
+    this->ratePpm = rate;
+    this->isLocked = (error < this->frameUsec) && (error > -this->frameUsec);
+}
+
+int64_t ServoShowClock::position()
+{
+    return (this->pos);
+}
+
+int ServoShowClock::frame()
+{
+    if (this->pos < 0)
+        return -1;
+    return (int)(this->pos / this->frameUsec);
+}
+
+bool ServoShowClock::locked()
+{
+    return (this->isLocked);
+}
+
+int ServoShowClock::readRatePpm()
+{
+    return (this->ratePpm);
+}
+
+void ServoShowClock::setMaxSlew(int ppm)
+{
+    if (ppm < 0)
+        ppm = 0;
+    else if (ppm > 500000)
+        ppm = 500000;     // never run backwards or at double speed
+    this->maxSlewPpm = ppm;
+}
+
+void ServoShowClock::setSeekThreshold(int32_t usec)
+{
+    if (usec < this->frameUsec)
+        usec = this->frameUsec;
+    this->seekUsec = usec;
+}
+
+bool ServoShowClock::drive(ServoMotionPlayer &player)
+{
+    int due = this->frame();
+    if ((due < 0) || (due == this->lastPlayed))
+        return false;
+    if (due != player.readFrame())
+        player.seek(due);      // late, early, or a jump: go straight to the frame
+    this->lastPlayed = due;
+    return (player.playFrame());
+}
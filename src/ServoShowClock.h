@@ -0,0 +1,111 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoShowClock.h - Timecode-locked playback clock for servo shows
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Playing show frames from loop() with delay() drifts away from the audio
+  and video. ServoShowClock keeps a local show position that runs from
+  micros(), and steers it towards an external timecode: small errors are
+  removed by running the clock slightly fast or slow (at most setMaxSlew()
+  parts per million, so the servos never jump), large errors (a cue jump or
+  a restart) are corrected by seeking at once. Timecode jitter is filtered,
+  and during a dropout the clock free-runs at its last corrected rate.
+
+  A timecode source is any class derived from ServoTimecodeSource (LTC,
+  MIDI timecode, a network message...). ServoLocalTimecode stands in for
+  one, running from micros().
+
+  The class methods are:
+
+    ServoShowClock(source, frameUsec) - Creates a clock following source;
+        frames are frameUsec long (default REFRESH_USEC).
+    void begin() / begin(nowUsec) - Starts the clock at the current
+        timecode (or zero if none is available).
+    void update() / update(nowUsec) - Advances the clock and steers it
+        towards the timecode; call this every time through loop().
+    int64_t position() - Show position in microseconds.
+    int frame() - Show frame due now (position / frameUsec).
+    bool locked() - True if the last timecode was within one frame.
+    int readRatePpm() - Current rate correction in parts per million.
+    void setMaxSlew(ppm) - Largest rate correction (default 20000, 2%).
+    void setSeekThreshold(usec) - Errors larger than this seek at once
+        (default 500000).
+    bool drive(player) - Plays the frame due now on a ServoMotionPlayer,
+        seeking it if needed; returns true if a frame was written.
+ */
+
+#ifndef ServoShowClock_h
+#define ServoShowClock_h
+
+#include <stdint.h>
+#include "ServoMotion.h"
+
+#define SERVO_CLOCK_MAX_SLEW_PPM      20000     // 2% faster or slower at most
+#define SERVO_CLOCK_SEEK_USEC        500000     // larger errors seek instead of slewing
+#define SERVO_CLOCK_FILTER_SHIFT          3     // timecode error filter: 1/8 new, 7/8 old
+
+class ServoTimecodeSource
+{
+public:
+  virtual ~ServoTimecodeSource() {}
+  virtual bool readTimecode(int64_t *showUsec) = 0;   // false during a dropout
+};
+
+class ServoLocalTimecode : public ServoTimecodeSource
+{
+public:
+  void start();                                // show time zero is now
+  bool readTimecode(int64_t *showUsec);
+
+  private:
+   int64_t elapsed = 0;
+   uint32_t lastUsec = 0;
+};
+
+class ServoShowClock
+{
+public:
+  ServoShowClock(ServoTimecodeSource &source, int frameUsec = REFRESH_USEC);
+  void begin();
+  void begin(uint32_t nowUsec);
+  void update();
+  void update(uint32_t nowUsec);
+  int64_t position();
+  int frame();
+  bool locked();
+  int readRatePpm();
+  void setMaxSlew(int ppm);
+  void setSeekThreshold(int32_t usec);
+  bool drive(ServoMotionPlayer &player);
+
+  private:
+   ServoTimecodeSource *source;
+   int frameUsec;
+   int64_t pos = 0;                            // show position, microseconds
+   uint32_t lastUsec = 0;                      // micros() at the last update
+   int32_t remainder = 0;                      // sub-microsecond part of the rate correction
+   int32_t filteredError = 0;                  // smoothed (timecode - position)
+   int ratePpm = 0;
+   int maxSlewPpm = SERVO_CLOCK_MAX_SLEW_PPM;
+   int32_t seekUsec = SERVO_CLOCK_SEEK_USEC;
+   bool isLocked = false;
+   int lastPlayed = -1;                        // frame most recently written by drive()
+};
+
+#endif
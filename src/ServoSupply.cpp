@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2017 John K. Bennett. All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+
+* Notes on the implementation:
+* A sag is what causes the brownout, so a sample below the filtered value
+* replaces it at once; only a rising voltage goes through the filter.
+* Deferral has hysteresis: it starts below the critical threshold and ends
+* above the low one, so the current drawn when the moves resume cannot
+* itself put the supply back under critical and make the servos chatter.
+* The pin is read with analogReadMilliVolts(), which applies the ADC
+* calibration burned into each chip's eFuses; a raw analogRead() count
+* scaled by hand can be off by a few hundred millivolts at the supply.
+*/
+
+#include "ServoSupply.h"
+#include "Arduino.h"
+
+ServoSupply::ServoSupply(int pin, int rTop, int rBottom)
+{
+    this->pin = pin;
+    this->rTop = (rTop > 0) ? rTop : 0;
+    this->rBottom = (rBottom > 0) ? rBottom : 1;
+}
+
+void ServoSupply::setThresholds(int nominalMv, int lowMv, int criticalMv)
+{
+    this->nominalMv = nominalMv;
+    this->lowMv = (lowMv < nominalMv) ? lowMv : nominalMv - 1;
+    this->criticalMv = (criticalMv <= this->lowMv) ? criticalMv : this->lowMv;
+}
+
+void ServoSupply::setMinScale(int scale)
+{
+    if (scale < 1)
+        scale = 1;
+    else if (scale > SERVO_SUPPLY_SCALE_ONE)
+        scale = SERVO_SUPPLY_SCALE_ONE;
+    this->minScale = scale;
+}
+
+void ServoSupply::setFullSpeed(int usPerFrame)
+{
+    this->fullSpeed = (usPerFrame > 0) ? usPerFrame : 1;
+}
+
+void ServoSupply::update()
+{
+    if (this->pin >= 0)
+        this->update((int)((int64_t)analogReadMilliVolts(this->pin) * (this->rTop + this->rBottom) / this->rBottom));
+}
+
+void ServoSupply::update(int millivolts)
+{
+    if ((this->filtered < 0) || (millivolts < this->filtered))
+        this->filtered = millivolts;
+    else
+        this->filtered += (millivolts - this->filtered) >> SERVO_SUPPLY_RISE_SHIFT;
+
+    int mv = this->filtered;
+    if (this->isDeferred)
+    {
+        if (mv > this->lowMv)
+            this->isDeferred = false;
+    }
+    else if (mv < this->criticalMv)
+    {
+        this->isDeferred = true;
+        this->deferCount++;
+    }
+
+    if (this->isDeferred)
+        this->scale = 0;
+    else if (mv >= this->nominalMv)
+        this->scale = SERVO_SUPPLY_SCALE_ONE;
+    else if (mv <= this->lowMv)
+        this->scale = this->minScale;
+    else
+        this->scale = this->minScale + (long)(SERVO_SUPPLY_SCALE_ONE - this->minScale) *
+                      (mv - this->lowMv) / (this->nominalMv - this->lowMv);
+}
+
+int ServoSupply::readMillivolts()
+{
+    return (this->filtered);
+}
+
+int ServoSupply::readScale()
+{
+    return (this->scale);
+}
+
+int ServoSupply::readFullSpeed()
+{
+    return (this->fullSpeed);
+}
+
+bool ServoSupply::deferred()
+{
+    return (this->isDeferred);
+}
+
+uint32_t ServoSupply::deferrals()
+{
+    return (this->deferCount);
+}
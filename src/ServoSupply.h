@@ -0,0 +1,99 @@
+ /*
+  Copyright (c) 2017 John K. Bennett. All right reserved.
+
+  ServoSupply.h - Supply voltage supervisor for ESP32 servo motions
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+  Fast moves draw the most current, and on a sagging battery they pull the
+  supply below the ESP32's brownout level. A ServoSupply samples the servo
+  supply voltage once per frame and turns it into a speed scale that a
+  ServoController, ServoPlanner or ServoArm (see their setSupply())
+  applies to all of its moves:
+
+    above nominal            full speed
+    nominal down to low      speed scaled linearly down to the minimum scale
+    below critical           moves are deferred (the servos hold where they
+                             are) until the voltage is back above low
+
+  ServoController moves without a speed limit (speed 0) are given the full
+  speed set with setFullSpeed() whenever the supply is below nominal. Falling voltage is
+  followed at once; rising voltage is filtered, so a recovering battery
+  does not bounce the speed up and down.
+
+  The class methods are:
+
+    ServoSupply(pin, rTop, rBottom) - Creates a supervisor reading the supply
+        on ADC pin through a divider of rTop (supply to pin) and rBottom (pin
+        to ground), in any one unit; the pin is read with the core's
+        calibrated analogReadMilliVolts(). pin -1 means the voltage is passed
+        to update(millivolts) instead.
+    void setThresholds(nominalMv, lowMv, criticalMv) - Sets the thresholds
+        (default 6000, 5200 and 4800 mV, for a 2S LiPo or 5 NiMH cells).
+    void setMinScale(scale) - Speed scale at the low threshold, out of
+        SERVO_SUPPLY_SCALE_ONE (default a quarter).
+    void setFullSpeed(usPerFrame) - Speed used for unlimited moves while the
+        supply is below nominal (default SERVO_SUPPLY_FULL_SPEED).
+    void update() / update(millivolts) - Takes one sample; call once per
+        frame, before the update() of whatever it scales.
+    int readMillivolts() - Filtered supply voltage.
+    int readScale() - Current speed scale (0 while moves are deferred).
+    int readFullSpeed() - Speed used for unlimited moves.
+    bool deferred() - True while moves are deferred.
+    uint32_t deferrals() - Number of times moves have been deferred.
+ */
+
+#ifndef ServoSupply_h
+#define ServoSupply_h
+
+#include <stdint.h>
+
+#define SERVO_SUPPLY_SCALE_ONE      256     // speed scale for full speed
+#define SERVO_SUPPLY_FULL_SPEED      40     // us per frame for unlimited moves on a low supply
+#define SERVO_SUPPLY_RISE_SHIFT       3     // rising voltage filter: 1/8 new, 7/8 old
+
+class ServoSupply
+{
+public:
+  ServoSupply(int pin = -1, int rTop = 0, int rBottom = 1);
+  void setThresholds(int nominalMv, int lowMv, int criticalMv);
+  void setMinScale(int scale);
+  void setFullSpeed(int usPerFrame);
+  void update();
+  void update(int millivolts);
+  int readMillivolts();
+  int readScale();
+  int readFullSpeed();
+  bool deferred();
+  uint32_t deferrals();
+
+  private:
+   int pin;
+   int rTop;                                  // the divider: supply = pin * (rTop + rBottom) / rBottom
+   int rBottom;
+   int nominalMv = 6000;
+   int lowMv = 5200;
+   int criticalMv = 4800;
+   int minScale = SERVO_SUPPLY_SCALE_ONE / 4;
+   int fullSpeed = SERVO_SUPPLY_FULL_SPEED;
+   int filtered = -1;                         // millivolts; -1 before the first sample
+   int scale = SERVO_SUPPLY_SCALE_ONE;
+   bool isDeferred = false;
+   uint32_t deferCount = 0;
+};
+
+#endif